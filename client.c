@@ -9,15 +9,35 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <time.h>
 
 // Taille maximale du tampon de lecture/écriture
 #define TAILLE_TAMPON BUFSIZ
 
+// Reprise de session après une coupure (voir le serveur, option -s)
+#define ANNONCE_JETON "Jeton de reprise : "
+#define REFUS_REPRISE "Jeton de reprise inconnu"
+#define COMMANDE_REPRISE "/resume "
+#define TAILLE_JETON 64
+#define ATTENTE_RECONNEXION_MIN_MS 250
+#define ATTENTE_RECONNEXION_MAX_MS 8000
+
+// Jeton de la session en cours ("" : aucune session à reprendre)
+static char jeton[TAILLE_JETON + 1] = "";
+
+// Ligne du serveur en cours de réception, pour y repérer le jeton
+static char ligne_serveur[TAILLE_TAMPON];
+static size_t longueur_ligne = 0;
+
+// L'utilisateur a demandé /exit : la fermeture qui suit est voulue
+static int depart_demande = 0;
+
 /**
  * Crée et connecte un client à un serveur donné (nom ou adresse IP) et port spécifié.
  * @param nom_serveur Le nom d'hôte ou l'adresse IP du serveur
  * @param port_serveur Le port TCP sur lequel se connecter
- * @return Le descripteur de la socket connectée au serveur
+ * @return Le descripteur de la socket connectée au serveur, -1 si le serveur
+ *         est introuvable ou injoignable
  */
 int creer_socket_client(const char *nom_serveur, unsigned short port_serveur)
 {
@@ -38,7 +58,7 @@ int creer_socket_client(const char *nom_serveur, unsigned short port_serveur)
         if (infos_hote == NULL) {
             perror("Impossible de résoudre le nom d'hôte");
             close(descripteur_client);
-            exit(EXIT_FAILURE);
+            return -1;
         }
     } else {
         // L'utilisateur a fourni une adresse IP directement
@@ -47,7 +67,7 @@ int creer_socket_client(const char *nom_serveur, unsigned short port_serveur)
         if (infos_hote == NULL) {
             perror("Impossible de résoudre l'adresse IP");
             close(descripteur_client);
-            exit(EXIT_FAILURE);
+            return -1;
         }
     }
 
@@ -64,12 +84,79 @@ int creer_socket_client(const char *nom_serveur, unsigned short port_serveur)
     if (connect(descripteur_client, (struct sockaddr *)&adresse_serveur, sizeof(adresse_serveur)) == -1) {
         perror("Échec de la connexion");
         close(descripteur_client);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     return descripteur_client;
 }
 
+/**
+ * Suit les lignes reçues du serveur : retient le jeton de reprise annoncé à
+ * l'inscription, l'oublie si une reprise est refusée
+ * @param octets Les octets reçus
+ * @param nb_octets Leur nombre
+ */
+void suivre_lignes_serveur(const unsigned char *octets, size_t nb_octets)
+{
+    for (size_t i = 0; i < nb_octets; i++) {
+        if (octets[i] != '\n') {
+            // Seul le début d'une ligne trop longue est gardé
+            if (longueur_ligne < sizeof(ligne_serveur) - 1) ligne_serveur[longueur_ligne++] = (char)octets[i];
+            continue;
+        }
+        ligne_serveur[longueur_ligne] = '\0';
+        if (strncmp(ligne_serveur, ANNONCE_JETON, strlen(ANNONCE_JETON)) == 0) {
+            snprintf(jeton, sizeof(jeton), "%.*s", TAILLE_JETON, ligne_serveur + strlen(ANNONCE_JETON));
+        } else if (strncmp(ligne_serveur, REFUS_REPRISE, strlen(REFUS_REPRISE)) == 0) {
+            jeton[0] = '\0';
+        }
+        longueur_ligne = 0;
+    }
+}
+
+/**
+ * Repère une commande /exit en début de ligne dans les octets tapés
+ * @param octets Les octets lus sur l'entrée standard
+ * @param nb_octets Leur nombre
+ */
+void suivre_lignes_utilisateur(const unsigned char *octets, size_t nb_octets)
+{
+    for (size_t debut = 0; debut < nb_octets; debut++) {
+        if ((debut == 0 || octets[debut - 1] == '\n') && nb_octets - debut >= 5 &&
+            memcmp(octets + debut, "/exit", 5) == 0 &&
+            (nb_octets - debut == 5 || octets[debut + 5] == '\n' || octets[debut + 5] == '\r')) {
+            depart_demande = 1;
+        }
+    }
+}
+
+/**
+ * Rétablit la connexion perdue, en espaçant de plus en plus les tentatives,
+ * puis demande la reprise de la session
+ * @param nom_serveur Le nom d'hôte ou l'adresse IP du serveur
+ * @param port_serveur Le port TCP sur lequel se connecter
+ * @return Le descripteur de la nouvelle socket
+ */
+int reconnecter(const char *nom_serveur, unsigned short port_serveur)
+{
+    long attente_ms = ATTENTE_RECONNEXION_MIN_MS;
+    int descripteur_client;
+
+    fprintf(stderr, ">>> Connexion perdue, reconnexion...\n");
+    while ((descripteur_client = creer_socket_client(nom_serveur, port_serveur)) == -1) {
+        struct timespec pause = { attente_ms / 1000, (attente_ms % 1000) * 1000000L };
+        nanosleep(&pause, NULL);
+        if (attente_ms < ATTENTE_RECONNEXION_MAX_MS) attente_ms *= 2;
+    }
+
+    // Le serveur lit cette ligne à la place du pseudo
+    char demande[sizeof(COMMANDE_REPRISE) + TAILLE_JETON + 1];
+    int longueur = snprintf(demande, sizeof(demande), "%s%s\n", COMMANDE_REPRISE, jeton);
+    write(descripteur_client, demande, (size_t)longueur);
+    longueur_ligne = 0;
+    return descripteur_client;
+}
+
 int main(int argc, char **argv)
 {
     const char *nom_serveur;
@@ -86,6 +173,9 @@ int main(int argc, char **argv)
 
     // Création et connexion du client
     descripteur_client = creer_socket_client(nom_serveur, port_serveur);
+    if (descripteur_client == -1) {
+        exit(EXIT_FAILURE);
+    }
 
     // Boucle principale : lecture via select() sur stdin et socket
     for (;;) {
@@ -115,13 +205,20 @@ int main(int argc, char **argv)
                 }else{
                     perror("read");
                 }
+                close(descripteur_client);
+
+                // Coupure subie avec une session en cours : on la reprend
+                if (!depart_demande && jeton[0] != '\0') {
+                    descripteur_client = reconnecter(nom_serveur, port_serveur);
+                    continue;
+                }
 
                 // Fermeture et sortie
-                close(descripteur_client);
                 exit(EXIT_FAILURE);
             }
 
             // Affichage du message reçu
+            suivre_lignes_serveur(tampon, (size_t)nb_octets);
             write(STDOUT_FILENO, tampon, nb_octets);
         }
 
@@ -138,6 +235,7 @@ int main(int argc, char **argv)
             }
 
             // Envoi au serveur
+            suivre_lignes_utilisateur(tampon, (size_t)nb_octets);
             write(descripteur_client, tampon, nb_octets);
         }
     }
@@ -1,2 +1,3 @@
 gcc -g -o server server.c
-gcc -g -o client client.c
\ No newline at end of file
+gcc -g -o client client.c
+gcc -g -O2 -o essaim essaim.c
\ No newline at end of file
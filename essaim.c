@@ -0,0 +1,465 @@
+// essaim.c
+// Générateur de charge : un essaim de bots se connecte au serveur, choisit un
+// pseudo, se répartit dans des salons et envoie des messages à débit fixé.
+// Chaque message porte son heure d'envoi : les bots qui le reçoivent mesurent
+// la latence de livraison de bout en bout.
+#include <errno.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define TAILLE_LIGNE 2048               // tampon de réception d'un bot
+#define MAX_EVENEMENTS 256
+#define DELAI_PREPARATION_S 30          // attente maximale des inscriptions
+#define DELAI_VIDANGE_S 2               // attente des derniers messages en vol
+
+// Histogramme des latences (µs) : 64 sous-classes linéaires par puissance de 2,
+// soit une précision relative de 1,6 %
+#define SOUS_CLASSES 64
+#define NB_PUISSANCES 40
+#define NB_CLASSES (NB_PUISSANCES * SOUS_CLASSES)
+
+// Étapes de la vie d'un bot
+#define BOT_CONNEXION 0     // connect() en cours
+#define BOT_PSEUDO 1        // pseudo envoyé, attente de la bienvenue
+#define BOT_SALON 2         // /join envoyé, attente de la confirmation
+#define BOT_PRET 3          // dans son salon, peut parler
+#define BOT_MORT 4          // connexion perdue
+
+typedef struct bot {
+    int descripteur;
+    int etat;
+    int salon;
+    int essais_pseudo;
+    size_t nb_recus;            // octets dans tampon
+    char tampon[TAILLE_LIGNE];
+} bot_t;
+
+typedef struct parametres {
+    const char *serveur;
+    unsigned short port;
+    int nb_connexions;
+    int nb_salons;
+    double debit;               // messages envoyés par seconde, tous bots confondus
+    double duree;               // secondes de mesure
+    int taille_message;
+    const char *etiquette;      // reprise telle quelle dans les résultats
+    const char *prefixe;        // en tête de chaque message de test (-c)
+} parametres_t;
+
+static bot_t *bots;
+static int *membres_par_salon;
+static uint64_t classes[NB_CLASSES];
+static uint64_t latence_max_us = 0;
+static char motif_test[48] = ": M ";    // repère d'un message de test reçu
+
+// Compteurs de la phase de mesure
+static uint64_t nb_envoyes = 0;
+static uint64_t nb_non_envoyes = 0;     // socket du bot pleine
+static uint64_t nb_attendus = 0;        // livraisons attendues (membres - 1 par message)
+static uint64_t nb_recus = 0;
+static uint64_t nb_deconnexions = 0;
+static int mesure_en_cours = 0;
+
+/**
+ * Horloge monotone en nanosecondes (commune aux bots d'un même processus)
+ */
+static uint64_t maintenant_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Classe d'histogramme d'une latence en microsecondes
+ */
+static int classe_de(uint64_t us) {
+    if (us < SOUS_CLASSES) return (int)us;
+    int puissance = 63 - __builtin_clzll(us) - 6;       // us >> puissance entre 64 et 127
+    int classe = puissance * SOUS_CLASSES + (int)(us >> puissance);
+    return classe < NB_CLASSES ? classe : NB_CLASSES - 1;
+}
+
+/**
+ * Plus petite latence rangée dans une classe
+ */
+static uint64_t borne_de(int classe) {
+    if (classe < SOUS_CLASSES) return (uint64_t)classe;
+    int puissance = classe / SOUS_CLASSES - 1;
+    return (uint64_t)(classe - puissance * SOUS_CLASSES) << puissance;
+}
+
+static void enregistrer_latence(uint64_t us) {
+    classes[classe_de(us)]++;
+    if (us > latence_max_us) latence_max_us = us;
+}
+
+/**
+ * Latence sous laquelle tombe la fraction q des messages reçus
+ */
+static uint64_t quantile(double q) {
+    uint64_t total = 0;
+    for (int i = 0; i < NB_CLASSES; i++) total += classes[i];
+    if (total == 0) return 0;
+    uint64_t rang = (uint64_t)(q * (double)total);
+    if (rang >= total) rang = total - 1;
+    uint64_t cumul = 0;
+    for (int i = 0; i < NB_CLASSES; i++) {
+        cumul += classes[i];
+        if (cumul > rang) return borne_de(i);
+    }
+    return latence_max_us;
+}
+
+/**
+ * Envoie une ligne complète ou rien (socket non bloquante)
+ * @return 0, ou -1 si la socket est pleine ou fermée
+ */
+static int envoyer_ligne(bot_t *bot, const char *ligne, size_t longueur) {
+    ssize_t n = send(bot->descripteur, ligne, longueur, MSG_NOSIGNAL);
+    return n == (ssize_t)longueur ? 0 : -1;
+}
+
+static void envoyer_pseudo(bot_t *bot, int numero) {
+    char ligne[64];
+    int longueur = snprintf(ligne, sizeof(ligne), "b%d_%d_%d\n", (int)getpid() % 100000, numero, bot->essais_pseudo);
+    bot->etat = BOT_PSEUDO;
+    envoyer_ligne(bot, ligne, (size_t)longueur);
+}
+
+static void bot_mort(bot_t *bot) {
+    if (bot->etat == BOT_PRET) membres_par_salon[bot->salon]--;
+    if (bot->etat != BOT_MORT) {
+        bot->etat = BOT_MORT;
+        nb_deconnexions++;
+        close(bot->descripteur);
+    }
+}
+
+/**
+ * Traite une ligne reçue par un bot : progression de l'inscription, ou
+ * message de test dont on mesure la latence
+ */
+static void traiter_ligne(bot_t *bot, int numero, char *ligne) {
+    switch (bot->etat) {
+        case BOT_PSEUDO:
+            if (strstr(ligne, "Bienvenue")) {
+                char commande[64];
+                int longueur = snprintf(commande, sizeof(commande), "/join s%d\n", bot->salon);
+                bot->etat = BOT_SALON;
+                envoyer_ligne(bot, commande, (size_t)longueur);
+            } else if (strstr(ligne, "déjà pris")) {
+                bot->essais_pseudo++;
+                envoyer_pseudo(bot, numero);
+            }
+            break;
+
+        case BOT_SALON:
+            if (strstr(ligne, "Vous avez rejoint")) {
+                bot->etat = BOT_PRET;
+                membres_par_salon[bot->salon]++;
+            }
+            break;
+
+        case BOT_PRET: {
+            // Message de test : "<préfixe><pseudo>: [-c] M <heure d'envoi ns> ..."
+            char *marque = strstr(ligne, motif_test);
+            if (!marque || !mesure_en_cours) break;
+            uint64_t envoi = strtoull(marque + strlen(motif_test), NULL, 10);
+            uint64_t reception = maintenant_ns();
+            if (envoi == 0 || envoi > reception) break;
+            enregistrer_latence((reception - envoi) / 1000);
+            nb_recus++;
+            break;
+        }
+    }
+}
+
+/**
+ * Lit tout ce que le serveur a envoyé à un bot et en découpe les lignes
+ */
+static void lire_bot(bot_t *bot, int numero) {
+    for (;;) {
+        ssize_t n = recv(bot->descripteur, bot->tampon + bot->nb_recus, sizeof(bot->tampon) - 1 - bot->nb_recus, 0);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            bot_mort(bot);
+            return;
+        }
+        bot->nb_recus += (size_t)n;
+        bot->tampon[bot->nb_recus] = '\0';
+
+        char *debut = bot->tampon;
+        char *fin;
+        while ((fin = strchr(debut, '\n')) != NULL) {
+            *fin = '\0';
+            traiter_ligne(bot, numero, debut);
+            if (bot->etat == BOT_MORT) return;
+            debut = fin + 1;
+        }
+        bot->nb_recus -= (size_t)(debut - bot->tampon);
+        memmove(bot->tampon, debut, bot->nb_recus);
+        // L'invite de pseudo n'a pas de '\n' : elle reste en tête de la ligne
+        // suivante. Une ligne plus longue que le tampon est jetée.
+        if (bot->nb_recus == sizeof(bot->tampon) - 1) bot->nb_recus = 0;
+    }
+}
+
+/**
+ * Prépare l'adresse du serveur (nom ou adresse IP)
+ */
+static void resoudre(const char *nom_serveur, unsigned short port, struct sockaddr_in *adresse) {
+    memset(adresse, 0, sizeof(*adresse));
+    adresse->sin_family = AF_INET;
+    adresse->sin_port = htons(port);
+    if (inet_pton(AF_INET, nom_serveur, &adresse->sin_addr) == 1) return;
+    struct hostent *infos_hote = gethostbyname(nom_serveur);
+    if (!infos_hote) {
+        fprintf(stderr, "Impossible de résoudre %s\n", nom_serveur);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&adresse->sin_addr, infos_hote->h_addr_list[0], (size_t)infos_hote->h_length);
+}
+
+/**
+ * Ouvre les connexions des bots, sans attendre leur établissement
+ */
+static void connecter_bots(int epoll, const parametres_t *p, const struct sockaddr_in *adresse) {
+    for (int i = 0; i < p->nb_connexions; i++) {
+        bot_t *bot = &bots[i];
+        bot->salon = i % p->nb_salons;
+        bot->descripteur = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (bot->descripteur == -1) {
+            perror("socket");
+            bot->etat = BOT_MORT;
+            continue;
+        }
+        int opt = 1;
+        setsockopt(bot->descripteur, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        if (connect(bot->descripteur, (const struct sockaddr *)adresse, sizeof(*adresse)) == -1 && errno != EINPROGRESS) {
+            perror("connect");
+            close(bot->descripteur);
+            bot->etat = BOT_MORT;
+            continue;
+        }
+        bot->etat = BOT_CONNEXION;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, bot->descripteur, &ev);
+    }
+}
+
+/**
+ * Traite les événements réseau pendant au plus delai_ms millisecondes
+ */
+static void traiter_evenements(int epoll, int delai_ms) {
+    struct epoll_event evenements[MAX_EVENEMENTS];
+    int nb = epoll_wait(epoll, evenements, MAX_EVENEMENTS, delai_ms);
+    for (int i = 0; i < nb; i++) {
+        int numero = (int)evenements[i].data.u32;
+        bot_t *bot = &bots[numero];
+        if (bot->etat == BOT_MORT) continue;
+        if (bot->etat == BOT_CONNEXION && (evenements[i].events & EPOLLOUT)) {
+            int erreur = 0;
+            socklen_t taille = sizeof(erreur);
+            getsockopt(bot->descripteur, SOL_SOCKET, SO_ERROR, &erreur, &taille);
+            if (erreur) {
+                bot_mort(bot);
+                continue;
+            }
+            envoyer_pseudo(bot, numero);
+        }
+        if (evenements[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            lire_bot(bot, numero);
+        }
+    }
+}
+
+static int compter_prets(int nb_connexions) {
+    int prets = 0;
+    for (int i = 0; i < nb_connexions; i++) {
+        if (bots[i].etat == BOT_PRET) prets++;
+    }
+    return prets;
+}
+
+/**
+ * Envoie le message de test d'un bot pris au hasard parmi ceux qui sont
+ * prêts ; faute d'en trouver un, le message compte comme non envoyé
+ * @return 0, ou -1 si aucun bot prêt n'a été trouvé
+ */
+static int envoyer_message_test(const parametres_t *p, char *ligne) {
+    for (int essai = 0; essai < 16; essai++) {
+        bot_t *bot = &bots[rand() % p->nb_connexions];
+        if (bot->etat != BOT_PRET) continue;
+        int entete = snprintf(ligne, 96, "%sM %llu ", p->prefixe, (unsigned long long)maintenant_ns());
+        memset(ligne + entete, 'x', (size_t)(p->taille_message > entete ? p->taille_message - entete : 0));
+        size_t longueur = (size_t)(p->taille_message > entete ? p->taille_message : entete);
+        ligne[longueur] = '\n';
+        if (envoyer_ligne(bot, ligne, longueur + 1) == 0) {
+            nb_envoyes++;
+            nb_attendus += (uint64_t)(membres_par_salon[bot->salon] - 1);
+        } else {
+            nb_non_envoyes++;
+        }
+        return 0;
+    }
+    nb_non_envoyes++;
+    return -1;
+}
+
+/**
+ * Écrit une chaîne entre guillemets, échappée pour JSON
+ */
+static void afficher_chaine_json(const char *texte) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)texte; *c; c++) {
+        if (*c == '"' || *c == '\\') printf("\\%c", *c);
+        else if (*c < 0x20) printf("\\u%04x", *c);
+        else putchar(*c);
+    }
+    putchar('"');
+}
+
+static void afficher_usage(const char *programme) {
+    fprintf(stderr, "Usage : %s [options] <serveur> <port>\n", programme);
+    fprintf(stderr, "  -n N       nombre de connexions (défaut : 1000)\n");
+    fprintf(stderr, "  -s N       nombre de salons entre lesquels les répartir (défaut : 10)\n");
+    fprintf(stderr, "  -r N       messages envoyés par seconde, tous bots confondus (défaut : 1000)\n");
+    fprintf(stderr, "  -d S       durée de la mesure en secondes (défaut : 10)\n");
+    fprintf(stderr, "  -l OCTETS  taille d'un message (défaut : 64)\n");
+    fprintf(stderr, "  -e TEXTE   étiquette recopiée dans les résultats (version du serveur...)\n");
+    fprintf(stderr, "  -c TEXTE   en tête de chaque message, par exemple une commande inconnue (\"/x \")\n");
+    fprintf(stderr, "             que le serveur diffuse et doit limiter par son débit de salon (-R)\n");
+    fprintf(stderr, "Résultats : résumé sur la sortie d'erreur, une ligne JSON sur la sortie standard\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    parametres_t p = { NULL, 0, 1000, 10, 1000.0, 10.0, 64, "", "" };
+    int option;
+    while ((option = getopt(argc, argv, "n:s:r:d:l:e:c:")) != -1) {
+        switch (option) {
+            case 'n': p.nb_connexions = atoi(optarg); break;
+            case 's': p.nb_salons = atoi(optarg); break;
+            case 'r': p.debit = atof(optarg); break;
+            case 'd': p.duree = atof(optarg); break;
+            case 'l': p.taille_message = atoi(optarg); break;
+            case 'e': p.etiquette = optarg; break;
+            case 'c': p.prefixe = optarg; break;
+            default: afficher_usage(argv[0]);
+        }
+    }
+    if (optind != argc - 2 || p.nb_connexions < 2 || p.nb_salons < 1 || p.debit <= 0 || p.duree <= 0
+        || p.taille_message < 1 || p.taille_message > 900 || strlen(p.prefixe) > 32) {
+        afficher_usage(argv[0]);
+    }
+    p.serveur = argv[optind];
+    p.port = (unsigned short)atoi(argv[optind + 1]);
+    srand((unsigned)getpid());
+    snprintf(motif_test, sizeof(motif_test), ": %sM ", p.prefixe);
+
+    // Une socket par bot
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0 && limite.rlim_cur < limite.rlim_max) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+
+    bots = calloc((size_t)p.nb_connexions, sizeof(bot_t));
+    membres_par_salon = calloc((size_t)p.nb_salons, sizeof(int));
+    if (!bots || !membres_par_salon) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    int epoll = epoll_create1(0);
+    if (epoll == -1) {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_in adresse;
+    resoudre(p.serveur, p.port, &adresse);
+
+    // Phase 1 : connexions, pseudos et salons
+    uint64_t debut = maintenant_ns();
+    connecter_bots(epoll, &p, &adresse);
+    int prets = 0;
+    while ((prets = compter_prets(p.nb_connexions)) + (int)nb_deconnexions < p.nb_connexions
+           && maintenant_ns() - debut < DELAI_PREPARATION_S * 1000000000ULL) {
+        traiter_evenements(epoll, 10);
+    }
+    double preparation = (double)(maintenant_ns() - debut) / 1e9;
+    fprintf(stderr, ">>> %d/%d bots prêts en %.2f s\n", prets, p.nb_connexions, preparation);
+    if (prets < 2) {
+        fprintf(stderr, "Pas assez de bots pour mesurer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Phase 2 : envoi à débit fixé pendant la durée demandée
+    char ligne[1024];
+    mesure_en_cours = 1;
+    debut = maintenant_ns();
+    uint64_t duree_ns = (uint64_t)(p.duree * 1e9);
+    uint64_t ecoule;
+    int plus_aucun_bot = 0;
+    while (!plus_aucun_bot && (ecoule = maintenant_ns() - debut) < duree_ns) {
+        uint64_t dus = (uint64_t)((double)ecoule / 1e9 * p.debit);
+        while (nb_envoyes + nb_non_envoyes < dus) {
+            if (envoyer_message_test(&p, ligne) < 0 && compter_prets(p.nb_connexions) == 0) {
+                // Serveur tombé ou tous les bots coupés : la mesure s'arrête là
+                fprintf(stderr, ">>> Plus aucun bot prêt après %.2f s de mesure\n", (double)ecoule / 1e9);
+                plus_aucun_bot = 1;
+                break;
+            }
+        }
+        traiter_evenements(epoll, 1);
+    }
+
+    // Phase 3 : réception des messages encore en vol
+    uint64_t fin_envoi = maintenant_ns();
+    while (nb_recus < nb_attendus && maintenant_ns() - fin_envoi < DELAI_VIDANGE_S * 1000000000ULL) {
+        traiter_evenements(epoll, 10);
+    }
+    double duree_reelle = (double)(maintenant_ns() - debut) / 1e9;
+
+    double envoyes_par_s = (double)nb_envoyes / p.duree;
+    double livraisons_par_s = (double)nb_recus / duree_reelle;
+    uint64_t p50 = quantile(0.50), p99 = quantile(0.99), p999 = quantile(0.999);
+
+    fprintf(stderr, ">>> %llu messages envoyés (%.0f/s), %llu livraisons sur %llu attendues (%.0f/s)\n",
+            (unsigned long long)nb_envoyes, envoyes_par_s,
+            (unsigned long long)nb_recus, (unsigned long long)nb_attendus, livraisons_par_s);
+    fprintf(stderr, ">>> Latence de livraison : p50 %llu µs, p99 %llu µs, p99.9 %llu µs, max %llu µs\n",
+            (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999,
+            (unsigned long long)latence_max_us);
+
+    printf("{\"etiquette\":");
+    afficher_chaine_json(p.etiquette);
+    printf(",\"connexions\":%d,\"prets\":%d,\"salons\":%d,\"debit_demande\":%.0f,"
+           "\"duree_s\":%.2f,\"taille_message\":%d,\"preparation_s\":%.3f,"
+           "\"envoyes\":%llu,\"non_envoyes\":%llu,\"attendus\":%llu,\"recus\":%llu,\"deconnexions\":%llu,"
+           "\"envoyes_par_s\":%.1f,\"livraisons_par_s\":%.1f,"
+           "\"latence_us\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+           p.nb_connexions, prets, p.nb_salons, p.debit,
+           p.duree, p.taille_message, preparation,
+           (unsigned long long)nb_envoyes, (unsigned long long)nb_non_envoyes,
+           (unsigned long long)nb_attendus, (unsigned long long)nb_recus, (unsigned long long)nb_deconnexions,
+           envoyes_par_s, livraisons_par_s,
+           (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999,
+           (unsigned long long)latence_max_us);
+    return 0;
+}
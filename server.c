@@ -1,441 +1,6612 @@
 // server.c
+#define _GNU_SOURCE     // accept4
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <netdb.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <time.h>
 
-#define MAX_CLIENTS 100
 #define MAX_PSEUDO 32
 #define MAX_MESSAGE 1024
-#define MAX_SALONS 50
 #define MAX_NOM_SALON 32
+#define MAX_LIGNE_DIFFUSEE (MAX_MESSAGE + MAX_PSEUDO + 4)    // préfixe, pseudo, ": ", ligne, '\n'
+#define MAX_REACTEURS 64
+#define MAX_EVENEMENTS 64
+#define TAILLE_ENTREE (2 * MAX_MESSAGE)      // tampon d'entrée circulaire (puissance de 2)
+#define MAX_IOV 64                          // segments écrits par appel à writev
+#define TAILLE_BLOC_MEMBRES 64              // membres par bloc plein
+#define CAPACITE_BLOC_MIN 4
+#define TAILLE_DALLE (64 * 1024)            // octets découpés à la fois par une réserve
+#define LIGNE_CACHE 64
+#define LIMITE_FILE_SORTIE_DEFAUT (256 * 1024)
+#define INTERVALLE_LOT_MS 10                // regroupement des écritures du journal
+#define DURABILITE_DEFAUT_MS 1000           // fdatasync du journal au plus une fois par intervalle
+#define MAX_JOURNAL_EN_ATTENTE (1 << 20)    // au-delà, les messages ne sont plus journalisés
+#define INTERVALLE_SYNTHESE_JOURNAL_S 60
+#define HISTORIQUE_DEFAUT 50                // messages récents gardés par salon
+#define OCTETS_HISTORIQUE_DEFAUT (32 * 1024)
+#define SUBDIVISIONS_HISTOGRAMME 4           // tranches par puissance de 2
+#define NB_TRANCHES_HISTOGRAMME (64 * SUBDIVISIONS_HISTOGRAMME)
+#define MAX_SALONS_STATS 20                 // salons détaillés par /stats (les plus peuplés)
+#define TAILLE_PAGE_LISTE 50                // lignes par page de /channels et /who
+#define MAX_PAGE_LISTE 1000000
+#define TIC_MS 100                          // résolution des délais des connexions
+#define NS_PAR_TIC (TIC_MS * 1000000ULL)
+#define NS_PAR_S 1000000000ULL
+#define BITS_NIVEAU_ROUE 6
+#define TAILLE_NIVEAU_ROUE (1 << BITS_NIVEAU_ROUE)
+#define NB_NIVEAUX_ROUE 4                   // 64^4 tics : un peu plus de 19 jours
+#define DELAI_INSCRIPTION_DEFAUT 30         // secondes pour donner un pseudo
+#define DELAI_LENTEUR_DEFAUT 60             // secondes de file de sortie bloquée
+#define DELAI_KEEPALIVE_DEFAUT 60           // secondes de silence avant les sondes TCP
+#define DELAI_COMMANDE_ADMINISTRATION_MS 100    // attente d'une commande sur la socket d'administration
+#define DEBIT_CLIENT_DEFAUT 20              // lignes par seconde et par connexion
+#define RAFALE_CLIENT_DEFAUT 40             // lignes acceptées d'affilée avant limitation
+#define VARIABLE_REPRISE "DM_CHAT_REPRISE"  // canal hérité par le processus de remplacement
+#define MAGIQUE_ETAT 0x52434d44u            // « DMCR »
+#define VERSION_ETAT 6
+#define MAX_DESCRIPTEURS_MESSAGE 250        // SCM_RIGHTS : au plus 253 par message
+#define DELAI_REPRISE_S 10                  // attente de la confirmation du remplaçant
+#define MAGIQUE_TRACE 0x52544d44u           // « DMTR »
+#define VERSION_TRACE 1
+#define SEUIL_TAMPON_TRACE (64 * 1024)      // au-delà, le tampon de trace d'un thread est écrit
+#define VERSION_FEDERATION 2
+#define MAX_PAIRS 16                        // nœuds désignés par -L
+#define MAX_SECRET 256                      // secret partagé de la grappe (-K)
+#define MAX_TRAME 4096                      // trame de fédération la plus longue acceptée
+#define LIMITE_SORTIE_LIEN (16 * 1024 * 1024)   // au-delà, le lien est coupé puis rétabli
+#define DELAI_RECONNEXION_MS 1000           // entre deux tentatives vers un pair injoignable
+#define DELAI_SESSION_DEFAUT 60             // secondes pendant lesquelles une session coupée peut être reprise
+#define TAILLE_JETON 16                     // octets aléatoires d'un jeton de reprise
+#define COMMANDE_REPRISE "/resume "         // à la place du pseudo : reprise d'une session
+#define MAGIQUE_CLICHE 0x53434d44u          // « DMCS »
+#define VERSION_CLICHE 2
+#define INTERVALLE_CLICHE_DEFAUT 30         // secondes entre deux clichés (s'il y a du nouveau)
 
 // Rôles possibles pour les utilisateurs
 #define ROLE_UTILISATEUR 0
 #define ROLE_MODERATEUR 1
 #define ROLE_ADMIN 2
 
+// États d'une connexion (machine à états du mode réacteur)
+#define ETAT_PSEUDO 0       // en attente d'un pseudo unique
+#define ETAT_CONNECTE 1     // inscrit dans un salon
+
+// Politiques appliquées quand la file de sortie d'un client est pleine
+#define DEBORDEMENT_ANCIEN 0        // jeter les plus anciens messages en attente
+#define DEBORDEMENT_DECONNECTER 1   // déconnecter le client trop lent
+#define DEBORDEMENT_RETARD 2        // marquer le client en retard, ignorer les nouveaux messages
+
+#define INVITE_PSEUDO "Entrez votre pseudo : "
+
+// Case d'un index à adressage ouvert (cle == NULL : case vide)
+typedef struct entree_index {
+    const void *cle;
+    size_t empreinte;
+    uintptr_t valeur;
+} entree_index_t;
+
+// Index à adressage ouvert : chaîne ou pointeur -> valeur
+typedef struct index_hachage {
+    entree_index_t *entrees;
+    size_t capacite;            // puissance de 2
+    size_t nb;
+    int cles_chaines;           // 1 : clés chaînes, 0 : clés pointeurs
+} index_t;
+
+// Message formaté une seule fois puis partagé, sans copie, par toutes les
+// files de sortie qui l'attendent ; libéré avec sa dernière référence
+typedef struct message {
+    _Atomic unsigned int references;
+    _Atomic int livraisons_restantes;   // partitions pas encore servies (diffusion mesurée)
+    uint64_t recu_ns;                   // lecture de la ligne d'origine, 0 : non mesuré
+    uint64_t sequence;                  // rang des lignes de salon, croissant (0 : hors historique)
+    size_t longueur;
+    char texte[];
+} message_t;
+
+// Message en attente d'écriture (le premier peut être déjà entamé)
+typedef struct segment_sortie {
+    message_t *message;
+} segment_sortie_t;
+
+// File de sortie bornée d'un client, vidée par writev quand la socket est inscriptible
+typedef struct file_sortie {
+    segment_sortie_t *segments;     // tableau circulaire
+    size_t capacite;                // nombre d'emplacements (puissance de 2)
+    size_t tete;                    // premier segment à écrire
+    size_t nb_segments;
+    size_t decalage;                // octets déjà écrits du segment de tête
+    size_t octets;                  // profondeur de la file en octets
+} file_sortie_t;
+
+// Octets reçus d'un client et pas encore découpés en lignes. Les indices
+// croissent sans fin et sont réduits modulo TAILLE_ENTREE ; le tampon n'est
+// pris dans pool_entrees que tant qu'une lecture est en cours ou qu'une ligne
+// est incomplète.
+typedef struct tampon_entree {
+    char *octets;
+    size_t debut;               // début de la ligne en cours
+    size_t fin;                 // fin des octets reçus
+    size_t examine;             // octets déjà parcourus à la recherche d'un '\n'
+    int a_ignorer;              // ligne trop longue : octets jetés jusqu'au prochain '\n'
+} tampon_entree_t;
+
+// Derniers messages d'un salon, gardés par référence dans un anneau de
+// capacite_historique emplacements alloué au premier message
+typedef struct historique {
+    pthread_mutex_t verrou;
+    message_t **messages;
+    size_t debut;               // plus ancien message
+    size_t nb;
+    size_t octets;              // texte retenu, borné par octets_historique_max
+    uint64_t sequence_chassee;  // plus grand rang chassé de l'anneau
+} historique_t;
+
+// Minuterie d'une roue, chaînée dans la case de son échéance (suivante ==
+// NULL : désarmée)
+typedef struct minuterie {
+    struct minuterie *precedente;
+    struct minuterie *suivante;
+    uint64_t echeance;          // en tics
+} minuterie_t;
+
+// Roue hiérarchique de minuteries propre à un réacteur : NB_NIVEAUX_ROUE
+// niveaux de TAILLE_NIVEAU_ROUE cases, chaque niveau TAILLE_NIVEAU_ROUE fois
+// plus grossier que le précédent. Armer et désarmer coûtent O(1) ; une
+// minuterie ne descend d'un niveau qu'au passage de sa case.
+typedef struct roue {
+    uint64_t maintenant;        // dernier tic traité
+    size_t nb;                  // minuteries armées
+    minuterie_t cases[NB_NIVEAUX_ROUE][TAILLE_NIVEAU_ROUE];    // têtes de listes circulaires
+} roue_t;
+
 // Structure représentant un client connecté
 typedef struct salon salon_t;
+typedef struct reacteur reacteur_t;
 typedef struct client {
     int descripteur;
     char pseudo[MAX_PSEUDO];
-    salon_t *salon_courant;
+    _Atomic(salon_t *) salon_courant;
+    _Atomic int role_courant;       // copie du rôle dans salon_courant, pour préfixer sans verrou
+    pthread_mutex_t verrou_salon;   // sérialise les changements de salon du client
+    size_t indice_liste;            // place dans liste_clients
+    int etat;
+    reacteur_t *reacteur;           // NULL en mode thread par connexion
+    tampon_entree_t entree;         // lignes en cours de réception
+    pthread_mutex_t verrou_sortie;  // protège les champs de sortie ci-dessous
+    file_sortie_t sortie;           // octets en attente (socket pleine)
+    int en_retard;                  // file pleine, nouveaux messages ignorés
+    unsigned long octets_perdus;    // octets jetés faute de place dans la file
+    int en_erreur;                  // écriture impossible, fermeture en cours
+    uint32_t adresse;               // IPv4 du pair, ordre de l'hôte
+    unsigned long octets_ecrits;    // progression de la sortie (sous verrou_sortie)
+    minuterie_t minuterie;          // prochain contrôle des délais (roue du réacteur)
+    uint64_t connexion_ns;
+    uint64_t derniere_entree_ns;
+    uint64_t controle_ns;           // dernier contrôle de la progression de la sortie
+    unsigned long octets_ecrits_controle;
+    int file_en_attente_controle;
+    uint64_t debit_prevu;           // seau à jetons des lignes reçues (voir prendre_jetons)
+    uint64_t reprise_ns;            // lecture suspendue jusque-là (débit dépassé), 0 sinon
+    struct client *connexion_precedente;    // connexions du réacteur, inscrites ou non
+    struct client *connexion_suivante;
+    uint32_t numero;                // identifiant de la connexion dans la trace
+    int differe;                    // sortie à écrire au regroupement du réacteur
+    size_t indice_differe;          // place dans reacteur->differes
+    char jeton[2 * TAILLE_JETON + 1];   // jeton de reprise en hexadécimal, "" : aucun
+    int sans_reprise;               // départ voulu ou forcé : aucune session gardée (sous verrou_sortie)
 } client_t;
 
-// Association client + rôle dans un salon
-typedef struct client_role {
-    client_t *client;
-    int role;
-} client_role_t;
+// Diffusion confiée à un autre réacteur, qui la livre à ses propres membres
+// du salon
+typedef struct courrier {
+    struct courrier *suivant;
+    salon_t *salon;             // référence prise, rendue après livraison
+    message_t *message;         // référence prise
+    client_t *client_exclu;     // seulement comparé, jamais déréférencé
+} courrier_t;
+
+// Boucle d'événements epoll servant une partie des connexions : elle accepte
+// sur sa propre socket d'écoute (SO_REUSEPORT) et relève sa boîte aux lettres
+struct reacteur {
+    int numero;                 // partition des salons servie par ce réacteur
+    int epoll;
+    int ecoute;
+    int reveil;                 // eventfd signalé quand la boîte cesse d'être vide
+    _Atomic(courrier_t *) boite;    // pile sans verrou : plusieurs producteurs, un lecteur
+    roue_t roue;                // délais des connexions du réacteur
+    client_t *connexions;       // toutes ses connexions (thread du réacteur seul)
+    client_t **differes;        // clients dont la sortie attend le regroupement
+    size_t nb_differes;
+    size_t capacite_differes;
+    uint64_t echeance_differes_ns;
+    pthread_t thread;
+};
+
+// Bloc de membres d'un salon, rangé en colonnes : les pointeurs clients
+// (seuls lus par les diffusions) puis les rôles, un octet chacun
+typedef struct bloc_membres {
+    int nb;
+    int capacite;
+    client_t *clients[];        // suivi de capacite rôles, voir roles_du_bloc()
+} bloc_membres_t;
+
+// Liste immuable des membres d'un salon, découpée en blocs : tous pleins
+// (TAILLE_BLOC_MEMBRES) sauf le dernier, dont la capacité suit la taille du
+// salon. Une modification publie une nouvelle liste qui ne recopie que les
+// blocs touchés ; les diffusions la parcourent sans prendre de verrou.
+typedef struct instantane_salon {
+    int nb_clients;
+    int nb_blocs;
+    bloc_membres_t *blocs[];
+} instantane_salon_t;
+
+// Membres d'un salon servis par un même réacteur (une seule partition en
+// mode thread par connexion)
+typedef struct partition_salon {
+    _Atomic(instantane_salon_t *) membres;      // dernière liste publiée
+    index_t index_membres;                      // client -> place dans membres (sous verrou)
+    uint64_t fin_fenetre_ns;                    // diffusions regroupées jusque-là (réacteur seul)
+} partition_salon_t;
+
+// Réserve d'objets de taille fixe découpés dans des dalles, jamais rendues au
+// système : connexions et salons ne passent plus par malloc/free
+typedef struct pool {
+    pthread_mutex_t verrou;
+    size_t taille_objet;        // arrondie à une ligne de cache
+    void *libres;               // objets libres chaînés par leur premier mot
+    size_t nb_dalles;
+    size_t nb_utilises;
+} pool_t;
+
+// Bannissement d'un pseudo ou d'une plage d'adresses IPv4 (préfixe CIDR)
+typedef struct regle_ban {
+    int par_adresse;
+    uint32_t reseau;            // ordre de l'hôte, bits hors préfixe à 0
+    int longueur_prefixe;
+    char pseudo[MAX_PSEUDO];
+    time_t expiration;          // 0 : définitif
+} regle_ban_t;
+
+typedef struct liste_bans {
+    regle_ban_t *regles;
+    size_t nb;
+    size_t capacite;
+} liste_bans_t;
+
+// Structure représentant un salon de discussion
+struct salon {
+    char nom_salon[MAX_NOM_SALON];
+    pthread_mutex_t verrou;                     // sérialise les arrivées, départs et rôles
+    partition_salon_t *partitions;              // nb_partitions, une par réacteur
+    int nb_membres;                             // toutes partitions (sous verrou)
+    int detruit;                                // plus aucune arrivée acceptée
+    int nb_sessions;                            // sessions coupées qui y reviendront (sous verrou)
+    size_t indice_liste;                        // place dans liste_salons
+    _Atomic unsigned int references;            // répertoire + courriers en attente
+    historique_t historique;                    // derniers messages, rejoués à l'arrivée
+    liste_bans_t bans;                          // bannis du salon (sous verrou)
+    index_t roles_retenus;                      // jeton du titulaire -> rôle rendu à chaque arrivée (sous verrou)
+    _Atomic uint64_t debit_prevu;               // seau à jetons des diffusions (voir prendre_jetons)
+};
+
+// Listes globales de clients et salons, agrandies à la demande, et leurs
+// index par pseudo et par nom ; chaque répertoire a son propre verrou
+static client_t **liste_clients = NULL;
+static salon_t **liste_salons = NULL;
+static size_t nb_clients_total = 0;
+static size_t nb_salons_total = 0;
+static size_t capacite_clients = 0;
+static size_t capacite_salons = 0;
+static index_t index_pseudos;
+static index_t index_salons;
+
+// Noms des salons triés, pour /channels : reconstruits à la première lecture
+// qui suit une création ou une suppression (version_salons a changé)
+typedef struct annuaire_salons {
+    unsigned long version;
+    size_t nb;
+    char noms[][MAX_NOM_SALON];
+} annuaire_salons_t;
+static _Atomic unsigned long version_salons = 1;
+static _Atomic unsigned long version_persistante = 1;  // rôles et bannissements, voir le cliché
+static _Atomic(annuaire_salons_t *) annuaire_salons = NULL;
+static pthread_mutex_t verrou_annuaire = PTHREAD_MUTEX_INITIALIZER;    // une reconstruction à la fois
+
+// Réserves des clients, des salons et des tampons d'entrée, octets occupés
+// par les listes de membres
+#define POOL_INITIALISEUR(taille) { PTHREAD_MUTEX_INITIALIZER, ((taille) + LIGNE_CACHE - 1) & ~(size_t)(LIGNE_CACHE - 1), NULL, 0, 0 }
+static pool_t pool_clients = POOL_INITIALISEUR(sizeof(client_t));
+static pool_t pool_salons = POOL_INITIALISEUR(sizeof(salon_t));
+static pool_t pool_entrees = POOL_INITIALISEUR(TAILLE_ENTREE);
+static _Atomic size_t octets_membres = 0;
+static pthread_mutex_t verrou_clients = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t verrou_salons = PTHREAD_MUTEX_INITIALIZER;
+static salon_t *salon_par_defaut = NULL;
+
+// Modèle d'exécution : réacteurs epoll (défaut) ou un thread par connexion
+static int mode_thread_par_connexion = 0;
+static reacteur_t liste_reacteurs[MAX_REACTEURS];
+static int nb_reacteurs = 0;
+static int nb_partitions = 1;
+static __thread reacteur_t *reacteur_courant = NULL;
+
+// Liste de membres d'une partition vide, partagée et jamais libérée
+static instantane_salon_t membres_vides = { 0, 0 };
+
+// Files de sortie : taille maximale, politique de débordement et compteurs
+static size_t limite_file_sortie = LIMITE_FILE_SORTIE_DEFAUT;
+static int politique_debordement = DEBORDEMENT_DECONNECTER;
+static _Atomic unsigned long octets_perdus_total = 0;
+static _Atomic unsigned long deconnexions_lenteur = 0;
+static uint64_t fenetre_groupement_ns = 0;    // regroupement des diffusions (0 : aucun)
+
+// Délais des connexions, en secondes (0 : aucun)
+static unsigned int delai_inscription_s = DELAI_INSCRIPTION_DEFAUT;
+static unsigned int delai_inactivite_s = 0;
+static unsigned int delai_lenteur_s = DELAI_LENTEUR_DEFAUT;
+static unsigned int delai_keepalive_s = DELAI_KEEPALIVE_DEFAUT;
+
+// Débits de lignes autorisés (seaux à jetons), par connexion et par salon
+typedef struct {
+    uint64_t intervalle_ns;     // entre deux lignes au débit nominal, 0 : illimité
+    uint64_t tolerance_ns;      // avance permise : rafale - 1 intervalles
+} debit_t;
+static debit_t debit_client = { NS_PAR_S / DEBIT_CLIENT_DEFAUT, (RAFALE_CLIENT_DEFAUT - 1) * (NS_PAR_S / DEBIT_CLIENT_DEFAUT) };
+static debit_t debit_salon = { 0, 0 };
+
+// Historique récent des salons : bornes par salon et mémoire retenue au total
+static size_t capacite_historique = HISTORIQUE_DEFAUT;
+static size_t octets_historique_max = OCTETS_HISTORIQUE_DEFAUT;
+static _Atomic size_t octets_historiques = 0;
+static _Atomic uint64_t prochaine_sequence = 1;     // rang de la prochaine ligne de salon
+
+// Message de salon en attente d'écriture dans le journal
+typedef struct entree_journal {
+    struct entree_journal *suivant;
+    struct timespec horodatage;
+    char salon[MAX_NOM_SALON];
+    message_t *message;         // référence prise
+} entree_journal_t;
+
+// Journal de l'historique et ses compteurs (à partir de nb_ecrits, écrits par
+// le seul thread du journal et lus par /stats)
+static struct {
+    int descripteur;                        // -1 : journal désactivé
+    int intervalle_durabilite_ms;
+    _Atomic(entree_journal_t *) pile;       // plusieurs producteurs, un lecteur
+    _Atomic unsigned long en_attente;
+    _Atomic unsigned long perdus;           // journal trop en retard
+    _Atomic unsigned long nb_ecrits;
+    _Atomic unsigned long nb_lots;
+    _Atomic unsigned long nb_fdatasync;
+    _Atomic unsigned long duree_ecriture_us;
+    _Atomic unsigned long duree_ecriture_max_us;
+    _Atomic unsigned long duree_fdatasync_us;
+    _Atomic unsigned long attente_max_us;   // du dépôt d'un message à son écriture
+} journal = { -1, DURABILITE_DEFAUT_MS, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/*
+ * Statistiques : chaque thread incrémente ses propres compteurs, sans verrou
+ * ni contention (un seul écrivain par bloc) ; /stats et la socket
+ * d'administration en font la somme. Le bloc d'un thread terminé est repris
+ * par le suivant et continue d'accumuler : les totaux ne perdent rien.
+ */
+enum {
+    STAT_CONNEXIONS,            // connexions acceptées
+    STAT_INSCRIPTIONS,          // pseudos acceptés
+    STAT_DECONNEXIONS,
+    STAT_LIGNES_RECUES,
+    STAT_OCTETS_RECUS,
+    STAT_MESSAGES_ENVOYES,      // un par destinataire
+    STAT_OCTETS_ENVOYES,        // effectivement écrits sur les sockets
+    STAT_VERROUS_DISPUTES,      // verrous trouvés déjà pris
+    STAT_DELAIS_DEPASSES,       // connexions fermées par la roue de minuteries
+    STAT_CONNEXIONS_REFUSEES,   // adresses bannies, refusées dès accept()
+    STAT_LIMITATIONS,           // lectures suspendues faute de jetons
+    STAT_ENVOIS_DIFFERES,       // messages gardés pour un regroupement
+    STAT_SESSIONS_GARDEES,      // connexions coupées dont la session attend une reprise
+    STAT_SESSIONS_REPRISES,
+    NB_STATS
+};
+
+static const char *const noms_stats[NB_STATS] = {
+    "connexions", "inscriptions", "deconnexions", "lignes_recues", "octets_recus",
+    "messages_envoyes", "octets_envoyes", "verrous_disputes", "delais_depasses", "connexions_refusees",
+    "limitations", "envois_differes", "sessions_gardees", "sessions_reprises"
+};
+
+// Histogramme log-linéaire de durées en nanosecondes
+typedef struct histogramme {
+    _Atomic uint64_t tranches[NB_TRANCHES_HISTOGRAMME];
+} histogramme_t;
+
+typedef struct statistiques {
+    _Atomic uint64_t compteurs[NB_STATS];
+    histogramme_t latence_diffusion;        // lecture -> écriture au dernier destinataire
+    histogramme_t attente_verrou;           // verrous disputés seulement
+    _Atomic int occupe;                     // bloc attribué à un thread vivant
+    struct statistiques *suivant;
+} statistiques_t;
+
+static _Atomic(statistiques_t *) liste_statistiques = NULL;
+static pthread_key_t cle_statistiques;
+static pthread_once_t init_statistiques = PTHREAD_ONCE_INIT;
+static __thread statistiques_t *mes_statistiques = NULL;
+static __thread uint64_t derniere_lecture_ns = 0;  // date du dernier read() de ce thread
+
+static uint64_t horloge_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Rend le bloc de statistiques d'un thread qui se termine
+ */
+static void rendre_statistiques(void *arg) {
+    statistiques_t *statistiques = arg;
+    atomic_store(&statistiques->occupe, 0);
+}
+
+static void creer_cle_statistiques(void) {
+    pthread_key_create(&cle_statistiques, rendre_statistiques);
+}
+
+/**
+ * Attribue au thread courant un bloc de statistiques (réutilisé si possible)
+ */
+static statistiques_t *obtenir_statistiques(void) {
+    if (mes_statistiques) return mes_statistiques;
+    pthread_once(&init_statistiques, creer_cle_statistiques);
+
+    for (statistiques_t *s = atomic_load(&liste_statistiques); s; s = s->suivant) {
+        int libre = 0;
+        if (atomic_compare_exchange_strong(&s->occupe, &libre, 1)) {
+            mes_statistiques = s;
+            break;
+        }
+    }
+    if (!mes_statistiques) {
+        statistiques_t *statistiques = calloc(1, sizeof(statistiques_t));
+        if (!statistiques) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        atomic_store(&statistiques->occupe, 1);
+        statistiques->suivant = atomic_load(&liste_statistiques);
+        while (!atomic_compare_exchange_weak(&liste_statistiques, &statistiques->suivant, statistiques));
+        mes_statistiques = statistiques;
+    }
+    pthread_setspecific(cle_statistiques, mes_statistiques);
+    return mes_statistiques;
+}
+
+/**
+ * Ajoute n à un compteur du thread courant. Seul ce thread écrit son bloc :
+ * une lecture et une écriture relâchées suffisent, sans instruction verrouillée.
+ */
+static void compter(int statistique, uint64_t n) {
+    _Atomic uint64_t *compteur = &obtenir_statistiques()->compteurs[statistique];
+    atomic_store_explicit(compteur, atomic_load_explicit(compteur, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/**
+ * Tranche d'une durée : SUBDIVISIONS_HISTOGRAMME tranches égales par puissance de 2
+ */
+static int tranche_histogramme(uint64_t duree_ns) {
+    if (duree_ns < SUBDIVISIONS_HISTOGRAMME) return (int)duree_ns;
+    int puissance = 63 - __builtin_clzll(duree_ns);     // >= 2
+    int subdivision = (int)(duree_ns >> (puissance - 2)) & (SUBDIVISIONS_HISTOGRAMME - 1);
+    return puissance * SUBDIVISIONS_HISTOGRAMME + subdivision;
+}
+
+/**
+ * Plus grande durée rangée dans une tranche
+ */
+static uint64_t borne_tranche(int tranche) {
+    if (tranche < 2 * SUBDIVISIONS_HISTOGRAMME) return (uint64_t)tranche;     // tranches 4 à 7 inutilisées
+    int puissance = tranche / SUBDIVISIONS_HISTOGRAMME;
+    uint64_t debut = (uint64_t)(SUBDIVISIONS_HISTOGRAMME + tranche % SUBDIVISIONS_HISTOGRAMME) << (puissance - 2);
+    return debut + (1ULL << (puissance - 2)) - 1;
+}
+
+static void mesurer(histogramme_t *histogramme, uint64_t duree_ns) {
+    _Atomic uint64_t *tranche = &histogramme->tranches[tranche_histogramme(duree_ns)];
+    atomic_store_explicit(tranche, atomic_load_explicit(tranche, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/**
+ * Prend un verrou ; seule l'attente d'un verrou déjà pris est chronométrée,
+ * un verrou libre ne coûte qu'un pthread_mutex_trylock()
+ */
+static void verrouiller(pthread_mutex_t *verrou) {
+    if (pthread_mutex_trylock(verrou) == 0) return;
+    uint64_t debut = horloge_ns();
+    pthread_mutex_lock(verrou);
+    statistiques_t *statistiques = obtenir_statistiques();
+    mesurer(&statistiques->attente_verrou, horloge_ns() - debut);
+    compter(STAT_VERROUS_DISPUTES, 1);
+}
+
+/*
+ * Lectures sans verrou : récupération de mémoire différée par époques.
+ * Un thread encadre ses lectures par rcu_lire_debut()/rcu_lire_fin() ; un objet
+ * retiré avec rcu_retirer() n'est libéré qu'une fois que tous les threads
+ * entrés en section de lecture avant son retrait en sont sortis.
+ */
+typedef struct lecteur {
+    _Atomic unsigned long epoque;   // époque observée, 0 hors section de lecture
+    _Atomic int occupe;             // emplacement attribué à un thread vivant
+    int profondeur;                 // imbrication des sections (propre au thread)
+    struct lecteur *suivant;
+} lecteur_t;
+
+typedef struct retrait {
+    void *objet;
+    void (*liberer)(void *);
+    unsigned long epoque;
+    struct retrait *suivant;
+} retrait_t;
+
+static _Atomic unsigned long epoque_globale = 1;
+static _Atomic(lecteur_t *) liste_lecteurs = NULL;
+static pthread_mutex_t verrou_retraits = PTHREAD_MUTEX_INITIALIZER;
+static retrait_t *liste_retraits = NULL;
+static pthread_key_t cle_lecteur;
+static pthread_once_t init_lecteurs = PTHREAD_ONCE_INIT;
+static __thread lecteur_t *mon_lecteur = NULL;
+
+/**
+ * Rend l'emplacement de lecteur d'un thread qui se termine
+ */
+static void rendre_lecteur(void *arg) {
+    lecteur_t *lecteur = arg;
+    atomic_store(&lecteur->epoque, 0);
+    atomic_store(&lecteur->occupe, 0);
+}
+
+static void creer_cle_lecteur(void) {
+    pthread_key_create(&cle_lecteur, rendre_lecteur);
+}
+
+/**
+ * Attribue au thread courant un emplacement de lecteur (réutilisé si possible)
+ */
+static lecteur_t *obtenir_lecteur(void) {
+    if (mon_lecteur) return mon_lecteur;
+    pthread_once(&init_lecteurs, creer_cle_lecteur);
+
+    for (lecteur_t *l = atomic_load(&liste_lecteurs); l; l = l->suivant) {
+        int libre = 0;
+        if (atomic_compare_exchange_strong(&l->occupe, &libre, 1)) {
+            mon_lecteur = l;
+            break;
+        }
+    }
+    if (!mon_lecteur) {
+        lecteur_t *lecteur = calloc(1, sizeof(lecteur_t));
+        if (!lecteur) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        atomic_store(&lecteur->occupe, 1);
+        lecteur->suivant = atomic_load(&liste_lecteurs);
+        while (!atomic_compare_exchange_weak(&liste_lecteurs, &lecteur->suivant, lecteur));
+        mon_lecteur = lecteur;
+    }
+    mon_lecteur->profondeur = 0;
+    pthread_setspecific(cle_lecteur, mon_lecteur);
+    return mon_lecteur;
+}
+
+/**
+ * Entre en section de lecture : les objets lus ne seront pas libérés avant la sortie
+ */
+void rcu_lire_debut(void) {
+    lecteur_t *lecteur = obtenir_lecteur();
+    if (lecteur->profondeur++ == 0) {
+        // Écriture séquentiellement cohérente : visible avant toute lecture partagée
+        atomic_store(&lecteur->epoque, atomic_load(&epoque_globale));
+    }
+}
+
+/**
+ * Sort de la section de lecture
+ */
+void rcu_lire_fin(void) {
+    if (--mon_lecteur->profondeur == 0) {
+        atomic_store_explicit(&mon_lecteur->epoque, 0, memory_order_release);
+    }
+}
+
+/**
+ * Confie un objet déjà détaché de toute structure partagée ; il sera libéré
+ * par liberer() quand plus aucun lecteur ne pourra le voir
+ */
+void rcu_retirer(void *objet, void (*liberer)(void *)) {
+    retrait_t *retrait = malloc(sizeof(retrait_t));
+    if (!retrait) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    retrait->objet = objet;
+    retrait->liberer = liberer;
+
+    verrouiller(&verrou_retraits);
+    unsigned long epoque = atomic_load(&epoque_globale);
+    retrait->epoque = epoque;
+    retrait->suivant = liste_retraits;
+    liste_retraits = retrait;
+
+    // L'époque avance quand tous les lecteurs actifs l'ont observée
+    int avancer = 1;
+    for (lecteur_t *l = atomic_load(&liste_lecteurs); l; l = l->suivant) {
+        unsigned long observee = atomic_load(&l->epoque);
+        if (observee != 0 && observee != epoque) {
+            avancer = 0;
+            break;
+        }
+    }
+    if (avancer) {
+        atomic_store(&epoque_globale, ++epoque);
+    }
+
+    // Tout objet retiré deux époques plus tôt n'est plus visible de personne
+    retrait_t *a_liberer = NULL;
+    for (retrait_t **r = &liste_retraits; *r; ) {
+        if ((*r)->epoque + 2 <= epoque) {
+            retrait_t *libre = *r;
+            *r = libre->suivant;
+            libre->suivant = a_liberer;
+            a_liberer = libre;
+        } else {
+            r = &(*r)->suivant;
+        }
+    }
+    pthread_mutex_unlock(&verrou_retraits);
+
+    while (a_liberer) {
+        retrait_t *suivant = a_liberer->suivant;
+        a_liberer->liberer(a_liberer->objet);
+        free(a_liberer);
+        a_liberer = suivant;
+    }
+}
+
+/**
+ * Prend un objet dans une réserve (contenu indéterminé)
+ */
+void *pool_allouer(pool_t *pool) {
+    verrouiller(&pool->verrou);
+    if (!pool->libres) {
+        // Nouvelle dalle, découpée en objets alignés sur une ligne de cache
+        size_t nb_objets = TAILLE_DALLE / pool->taille_objet;
+        if (nb_objets == 0) nb_objets = 1;
+        char *dalle = aligned_alloc(LIGNE_CACHE, nb_objets * pool->taille_objet);
+        if (!dalle) {
+            perror("aligned_alloc");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = nb_objets; i > 0; i--) {
+            void *objet = dalle + (i - 1) * pool->taille_objet;
+            *(void **)objet = pool->libres;
+            pool->libres = objet;
+        }
+        pool->nb_dalles++;
+    }
+    void *objet = pool->libres;
+    pool->libres = *(void **)objet;
+    pool->nb_utilises++;
+    pthread_mutex_unlock(&pool->verrou);
+    return objet;
+}
+
+/**
+ * Rend un objet à sa réserve
+ */
+void pool_rendre(pool_t *pool, void *objet) {
+    verrouiller(&pool->verrou);
+    *(void **)objet = pool->libres;
+    pool->libres = objet;
+    pool->nb_utilises--;
+    pthread_mutex_unlock(&pool->verrou);
+}
+
+/**
+ * Octets réservés par une réserve (objets utilisés et libres)
+ */
+size_t pool_octets(pool_t *pool) {
+    verrouiller(&pool->verrou);
+    size_t nb_objets = TAILLE_DALLE / pool->taille_objet;
+    size_t octets = pool->nb_dalles * (nb_objets ? nb_objets : 1) * pool->taille_objet;
+    pthread_mutex_unlock(&pool->verrou);
+    return octets;
+}
+
+/*
+ * Index à adressage ouvert : sondage linéaire, suppression par décalage
+ * arrière (pas de pierres tombales), doublement au-delà de 70 % de remplissage.
+ * Les clés sont soit des chaînes (pseudo, nom de salon), soit des pointeurs ;
+ * elles doivent rester valides tant qu'elles sont dans l'index.
+ */
+static size_t hacher_cle(const index_t *index, const void *cle) {
+    if (!index->cles_chaines) {
+        uintptr_t x = (uintptr_t)cle;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return (size_t)x;
+    }
+    // FNV-1a
+    size_t h = 14695981039346656037ULL;
+    for (const unsigned char *c = cle; *c; c++) {
+        h ^= *c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int cles_egales(const index_t *index, const entree_index_t *entree, const void *cle, size_t empreinte) {
+    if (!index->cles_chaines) return entree->cle == cle;
+    return entree->empreinte == empreinte && strcmp(entree->cle, cle) == 0;
+}
+
+/**
+ * Prépare un index vide
+ */
+void index_initialiser(index_t *index, int cles_chaines) {
+    memset(index, 0, sizeof(index_t));
+    index->cles_chaines = cles_chaines;
+}
+
+/**
+ * Libère les cases d'un index (pas les objets indexés)
+ */
+void index_liberer(index_t *index) {
+    free(index->entrees);
+    index->entrees = NULL;
+    index->capacite = index->nb = 0;
+}
+
+static void index_agrandir(index_t *index) {
+    size_t capacite = index->capacite ? index->capacite * 2 : 16;
+    entree_index_t *entrees = calloc(capacite, sizeof(entree_index_t));
+    if (!entrees) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < index->capacite; i++) {
+        entree_index_t *entree = &index->entrees[i];
+        if (!entree->cle) continue;
+        size_t j = entree->empreinte & (capacite - 1);
+        while (entrees[j].cle) j = (j + 1) & (capacite - 1);
+        entrees[j] = *entree;
+    }
+    free(index->entrees);
+    index->entrees = entrees;
+    index->capacite = capacite;
+}
+
+/**
+ * Recherche une clé
+ * @return l'entrée trouvée, ou NULL
+ */
+entree_index_t *index_chercher(const index_t *index, const void *cle) {
+    if (index->nb == 0) return NULL;
+    size_t empreinte = hacher_cle(index, cle);
+    size_t masque = index->capacite - 1;
+    for (size_t i = empreinte & masque; index->entrees[i].cle; i = (i + 1) & masque) {
+        if (cles_egales(index, &index->entrees[i], cle, empreinte)) {
+            return &index->entrees[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Associe une valeur à une clé (remplace la valeur si la clé existe déjà)
+ */
+void index_inserer(index_t *index, const void *cle, uintptr_t valeur) {
+    if ((index->nb + 1) * 10 > index->capacite * 7) {
+        index_agrandir(index);
+    }
+    size_t empreinte = hacher_cle(index, cle);
+    size_t masque = index->capacite - 1;
+    size_t i = empreinte & masque;
+    for (; index->entrees[i].cle; i = (i + 1) & masque) {
+        if (cles_egales(index, &index->entrees[i], cle, empreinte)) {
+            index->entrees[i].valeur = valeur;
+            return;
+        }
+    }
+    index->entrees[i].cle = cle;
+    index->entrees[i].empreinte = empreinte;
+    index->entrees[i].valeur = valeur;
+    index->nb++;
+}
+
+/**
+ * Supprime une clé ; les entrées suivantes de la même grappe reculent
+ * pour rester atteignables
+ */
+void index_supprimer(index_t *index, const void *cle) {
+    entree_index_t *entree = index_chercher(index, cle);
+    if (!entree) return;
+    size_t masque = index->capacite - 1;
+    size_t trou = (size_t)(entree - index->entrees);
+    for (size_t j = (trou + 1) & masque; index->entrees[j].cle; j = (j + 1) & masque) {
+        size_t origine = index->entrees[j].empreinte & masque;
+        // L'entrée j peut combler le trou si sa case d'origine n'est pas dans ]trou, j]
+        int dans_intervalle = trou <= j ? (origine > trou && origine <= j)
+                                        : (origine > trou || origine <= j);
+        if (!dans_intervalle) {
+            index->entrees[trou] = index->entrees[j];
+            trou = j;
+        }
+    }
+    index->entrees[trou].cle = NULL;
+    index->nb--;
+}
+
+// Texte de longueur quelconque, agrandi à la demande
+typedef struct texte {
+    char *octets;
+    size_t longueur;
+    size_t capacite;
+} texte_t;
+
+static void texte_ajouter(texte_t *texte, const char *format, ...) {
+    for (;;) {
+        va_list arguments;
+        va_start(arguments, format);
+        size_t libre = texte->capacite - texte->longueur;
+        int n = vsnprintf(texte->octets ? texte->octets + texte->longueur : NULL, libre, format, arguments);
+        va_end(arguments);
+        if (n < 0) return;
+        if ((size_t)n < libre) {
+            texte->longueur += (size_t)n;
+            return;
+        }
+        texte->capacite = (texte->longueur + (size_t)n + 1) * 2;
+        texte->octets = realloc(texte->octets, texte->capacite);
+        if (!texte->octets) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void texte_copier(texte_t *texte, const void *octets, size_t longueur) {
+    if (texte->longueur + longueur > texte->capacite) {
+        texte->capacite = (texte->longueur + longueur) * 2;
+        texte->octets = realloc(texte->octets, texte->capacite);
+        if (!texte->octets) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(texte->octets + texte->longueur, octets, longueur);
+    texte->longueur += longueur;
+}
+
+/*
+ * Roue de minuteries : un seul thread (le réacteur propriétaire) l'utilise,
+ * aucune synchronisation.
+ */
+
+static void roue_initialiser(roue_t *roue, uint64_t maintenant) {
+    roue->maintenant = maintenant;
+    roue->nb = 0;
+    for (int n = 0; n < NB_NIVEAUX_ROUE; n++) {
+        for (int i = 0; i < TAILLE_NIVEAU_ROUE; i++) {
+            roue->cases[n][i].precedente = roue->cases[n][i].suivante = &roue->cases[n][i];
+        }
+    }
+}
+
+/**
+ * Range une minuterie au niveau du plus haut groupe de bits où son échéance
+ * diffère du tic courant (échéance au plus tôt au tic courant)
+ */
+static void roue_ranger(roue_t *roue, minuterie_t *minuterie) {
+    int niveau = 0;
+    while (niveau < NB_NIVEAUX_ROUE - 1 &&
+           (minuterie->echeance ^ roue->maintenant) >> (BITS_NIVEAU_ROUE * (niveau + 1))) {
+        niveau++;
+    }
+    minuterie_t *tete = &roue->cases[niveau][(minuterie->echeance >> (BITS_NIVEAU_ROUE * niveau)) & (TAILLE_NIVEAU_ROUE - 1)];
+    minuterie->precedente = tete->precedente;
+    minuterie->suivante = tete;
+    tete->precedente->suivante = minuterie;
+    tete->precedente = minuterie;
+}
+
+static void roue_detacher(minuterie_t *minuterie) {
+    minuterie->precedente->suivante = minuterie->suivante;
+    minuterie->suivante->precedente = minuterie->precedente;
+    minuterie->suivante = minuterie->precedente = NULL;
+}
+
+/**
+ * Arme (ou réarme) une minuterie pour le tic donné
+ */
+void roue_armer(roue_t *roue, minuterie_t *minuterie, uint64_t echeance) {
+    uint64_t maximum = roue->maintenant + ((uint64_t)1 << (BITS_NIVEAU_ROUE * NB_NIVEAUX_ROUE)) - 1;
+    if (minuterie->suivante) roue_detacher(minuterie);
+    else roue->nb++;
+    minuterie->echeance = echeance <= roue->maintenant ? roue->maintenant + 1 : echeance < maximum ? echeance : maximum;
+    roue_ranger(roue, minuterie);
+}
+
+void roue_desarmer(roue_t *roue, minuterie_t *minuterie) {
+    if (!minuterie->suivante) return;
+    roue_detacher(minuterie);
+    roue->nb--;
+}
+
+/**
+ * Avance la roue jusqu'au tic donné et appelle expirer() pour chaque
+ * minuterie échue, désarmée au moment de l'appel (elle peut être réarmée)
+ */
+void roue_avancer(roue_t *roue, uint64_t jusqua, void (*expirer)(minuterie_t *)) {
+    while (roue->maintenant < jusqua) {
+        roue->maintenant++;
+
+        // Au passage d'une case d'un niveau supérieur, ses minuteries
+        // redescendent, en commençant par le niveau le plus haut concerné
+        int niveau = 0;
+        while (niveau < NB_NIVEAUX_ROUE - 1 &&
+               ((roue->maintenant >> (BITS_NIVEAU_ROUE * niveau)) & (TAILLE_NIVEAU_ROUE - 1)) == 0) {
+            niveau++;
+        }
+        for (; niveau > 0; niveau--) {
+            minuterie_t *tete = &roue->cases[niveau][(roue->maintenant >> (BITS_NIVEAU_ROUE * niveau)) & (TAILLE_NIVEAU_ROUE - 1)];
+            while (tete->suivante != tete) {
+                minuterie_t *minuterie = tete->suivante;
+                roue_detacher(minuterie);
+                roue_ranger(roue, minuterie);
+            }
+        }
+
+        // La case est vidée avant les rappels, qui peuvent réarmer au même endroit
+        minuterie_t *tete = &roue->cases[0][roue->maintenant & (TAILLE_NIVEAU_ROUE - 1)];
+        if (tete->suivante == tete) continue;
+        minuterie_t echues = { tete->precedente, tete->suivante, 0 };
+        echues.suivante->precedente = &echues;
+        echues.precedente->suivante = &echues;
+        tete->precedente = tete->suivante = tete;
+        while (echues.suivante != &echues) {
+            minuterie_t *minuterie = echues.suivante;
+            roue_detacher(minuterie);
+            roue->nb--;
+            expirer(minuterie);
+        }
+    }
+}
+
+/**
+ * Prochain tic à traiter, en millisecondes depuis maintenant (-1 : roue vide)
+ */
+int roue_attente_ms(const roue_t *roue, uint64_t maintenant_ms) {
+    if (roue->nb == 0) return -1;
+    return (int)(TIC_MS - maintenant_ms % TIC_MS);
+}
+
+/**
+ * Renvoie un préfixe selon le rôle (pour distinguer admin/modérateur)
+ */
+const char *obtenir_prefixe_selon_role(int role) {
+    switch (role) {
+        case ROLE_ADMIN: return "@";
+        case ROLE_MODERATEUR: return "#";
+        default: return "";
+    }
+}
+
+/**
+ * Garantit la place d'un élément de plus dans un tableau dynamique
+ * (capacité doublée quand il est plein)
+ */
+static void *reserver_place(void *tableau, size_t nb, size_t *capacite, size_t taille_element) {
+    if (nb < *capacite) return tableau;
+    size_t nouvelle_capacite = *capacite ? *capacite * 2 : 64;
+    void *nouveau = realloc(tableau, nouvelle_capacite * taille_element);
+    if (!nouveau) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    *capacite = nouvelle_capacite;
+    return nouveau;
+}
+
+/**
+ * Recherche un salon par son nom (verrou_salons tenu)
+ */
+salon_t *trouver_salon(const char *nom) {
+    entree_index_t *entree = index_chercher(&index_salons, nom);
+    return entree ? (salon_t *)entree->valeur : NULL;
+}
+
+/**
+ * Rôles d'un bloc de membres, rangés après ses pointeurs clients
+ */
+static unsigned char *roles_du_bloc(bloc_membres_t *bloc) {
+    return (unsigned char *)&bloc->clients[bloc->capacite];
+}
+
+static size_t taille_bloc(int capacite) {
+    return sizeof(bloc_membres_t) + (size_t)capacite * (sizeof(client_t *) + 1);
+}
+
+static size_t taille_instantane(int nb_blocs) {
+    return sizeof(instantane_salon_t) + (size_t)nb_blocs * sizeof(bloc_membres_t *);
+}
+
+/**
+ * Alloue un bloc de membres et y recopie au plus capacite membres d'un bloc existant
+ */
+static bloc_membres_t *copier_bloc(bloc_membres_t *source, int capacite) {
+    bloc_membres_t *bloc = malloc(taille_bloc(capacite));
+    if (!bloc) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    bloc->capacite = capacite;
+    bloc->nb = 0;
+    if (source) {
+        bloc->nb = source->nb < capacite ? source->nb : capacite;
+        memcpy(bloc->clients, source->clients, (size_t)bloc->nb * sizeof(client_t *));
+        memcpy(roles_du_bloc(bloc), roles_du_bloc(source), (size_t)bloc->nb);
+    }
+    atomic_fetch_add_explicit(&octets_membres, taille_bloc(capacite), memory_order_relaxed);
+    return bloc;
+}
+
+static void liberer_bloc(void *objet) {
+    bloc_membres_t *bloc = objet;
+    atomic_fetch_sub_explicit(&octets_membres, taille_bloc(bloc->capacite), memory_order_relaxed);
+    free(bloc);
+}
+
+/**
+ * Alloue une liste de nb_blocs blocs partageant ceux d'une liste existante
+ */
+static instantane_salon_t *copier_instantane(const instantane_salon_t *source, int nb_blocs) {
+    instantane_salon_t *membres = malloc(taille_instantane(nb_blocs));
+    if (!membres) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    membres->nb_clients = source ? source->nb_clients : 0;
+    membres->nb_blocs = nb_blocs;
+    if (source) {
+        int nb_communs = source->nb_blocs < nb_blocs ? source->nb_blocs : nb_blocs;
+        memcpy(membres->blocs, source->blocs, (size_t)nb_communs * sizeof(bloc_membres_t *));
+    }
+    atomic_fetch_add_explicit(&octets_membres, taille_instantane(nb_blocs), memory_order_relaxed);
+    return membres;
+}
+
+static void liberer_instantane(void *objet) {
+    instantane_salon_t *membres = objet;
+    atomic_fetch_sub_explicit(&octets_membres, taille_instantane(membres->nb_blocs), memory_order_relaxed);
+    free(membres);
+}
+
+/**
+ * Lit le rôle du membre rangé à une place donnée
+ */
+static int role_a_la_place(const instantane_salon_t *membres, size_t place) {
+    return roles_du_bloc(membres->blocs[place / TAILLE_BLOC_MEMBRES])[place % TAILLE_BLOC_MEMBRES];
+}
+
+/**
+ * Partition d'un salon où se range un client : celle de son réacteur
+ */
+static partition_salon_t *partition_du_client(salon_t *salon, client_t *client) {
+    return &salon->partitions[client->reacteur ? client->reacteur->numero : 0];
+}
+
+/**
+ * Recherche le rôle d'un client dans un salon donné
+ */
+int obtenir_role_dans_salon(salon_t *salon, client_t *client) {
+    int role = ROLE_UTILISATEUR;
+    partition_salon_t *partition = partition_du_client(salon, client);
+    verrouiller(&salon->verrou);
+    entree_index_t *entree = index_chercher(&partition->index_membres, client);
+    if (entree) {
+        role = role_a_la_place(atomic_load_explicit(&partition->membres, memory_order_relaxed), entree->valeur);
+    }
+    pthread_mutex_unlock(&salon->verrou);
+    return role;
+}
+
+/**
+ * Recherche un client inscrit par son pseudo (section de lecture)
+ */
+client_t *trouver_client_par_pseudo(const char *pseudo) {
+    verrouiller(&verrou_clients);
+    entree_index_t *entree = index_chercher(&index_pseudos, pseudo);
+    client_t *client = entree ? (client_t *)entree->valeur : NULL;
+    pthread_mutex_unlock(&verrou_clients);
+    return client;
+}
+
+/**
+ * Recherche un membre d'un salon par son pseudo (section de lecture)
+ */
+client_t *trouver_membre_par_pseudo(salon_t *salon, const char *pseudo, int *role) {
+    client_t *client = trouver_client_par_pseudo(pseudo);
+    if (!client) return NULL;
+
+    partition_salon_t *partition = partition_du_client(salon, client);
+    verrouiller(&salon->verrou);
+    entree_index_t *entree = index_chercher(&partition->index_membres, client);
+    if (entree && role) {
+        *role = role_a_la_place(atomic_load_explicit(&partition->membres, memory_order_relaxed), entree->valeur);
+    }
+    pthread_mutex_unlock(&salon->verrou);
+    return entree ? client : NULL;
+}
+
+/**
+ * Remplace la liste des membres d'une partition (verrou du salon tenu).
+ * L'ancienne liste et les blocs qu'elle seule référençait sont libérés quand
+ * plus aucune diffusion ne les parcourt ; une partition vidée reprend la
+ * liste vide partagée.
+ */
+static void publier_membres(partition_salon_t *partition, instantane_salon_t *nouveaux) {
+    instantane_salon_t *anciens = atomic_load_explicit(&partition->membres, memory_order_relaxed);
+    if (nouveaux->nb_clients == 0) {
+        liberer_instantane(nouveaux);
+        nouveaux = &membres_vides;
+    }
+    atomic_store_explicit(&partition->membres, nouveaux, memory_order_release);
+    for (int i = 0; i < anciens->nb_blocs; i++) {
+        if (i >= nouveaux->nb_blocs || nouveaux->blocs[i] != anciens->blocs[i]) {
+            rcu_retirer(anciens->blocs[i], liberer_bloc);
+        }
+    }
+    if (anciens != &membres_vides) rcu_retirer(anciens, liberer_instantane);
+}
+
+/**
+ * Ajoute un membre en fin de liste (verrou du salon tenu) : seul le dernier
+ * bloc est recopié, et agrandi s'il est plein
+ */
+static void inserer_membre(partition_salon_t *partition, client_t *client, int role) {
+    instantane_salon_t *anciens = atomic_load_explicit(&partition->membres, memory_order_relaxed);
+    bloc_membres_t *dernier = anciens->nb_blocs ? anciens->blocs[anciens->nb_blocs - 1] : NULL;
+    instantane_salon_t *nouveaux;
+    bloc_membres_t *bloc;
+    if (!dernier || dernier->nb == TAILLE_BLOC_MEMBRES) {
+        nouveaux = copier_instantane(anciens, anciens->nb_blocs + 1);
+        bloc = copier_bloc(NULL, CAPACITE_BLOC_MIN);
+    } else {
+        nouveaux = copier_instantane(anciens, anciens->nb_blocs);
+        bloc = copier_bloc(dernier, dernier->nb == dernier->capacite ? dernier->capacite * 2 : dernier->capacite);
+    }
+    nouveaux->blocs[nouveaux->nb_blocs - 1] = bloc;
+    bloc->clients[bloc->nb] = client;
+    roles_du_bloc(bloc)[bloc->nb] = (unsigned char)role;
+    bloc->nb++;
+    index_inserer(&partition->index_membres, client, (uintptr_t)anciens->nb_clients);
+    nouveaux->nb_clients = anciens->nb_clients + 1;
+    publier_membres(partition, nouveaux);
+}
+
+/**
+ * Supprime un membre (verrou du salon tenu) : le dernier membre prend sa
+ * place, seuls son bloc et le dernier bloc sont recopiés
+ * @return 1 si le client était membre
+ */
+static int supprimer_membre(partition_salon_t *partition, client_t *client) {
+    instantane_salon_t *anciens = atomic_load_explicit(&partition->membres, memory_order_relaxed);
+    entree_index_t *entree = index_chercher(&partition->index_membres, client);
+    if (!entree) return 0;
+    size_t place = entree->valeur;
+    size_t derniere_place = (size_t)anciens->nb_clients - 1;
+
+    int indice_dernier = anciens->nb_blocs - 1;
+    bloc_membres_t *dernier = anciens->blocs[indice_dernier];
+    client_t *deplace = dernier->clients[dernier->nb - 1];
+    unsigned char role_deplace = roles_du_bloc(dernier)[dernier->nb - 1];
+
+    instantane_salon_t *nouveaux = copier_instantane(anciens, dernier->nb > 1 ? anciens->nb_blocs : indice_dernier);
+    nouveaux->nb_clients = anciens->nb_clients - 1;
+    bloc_membres_t *nouveau_dernier = NULL;
+    if (dernier->nb > 1) {
+        // Le dernier bloc rapetisse quand il n'est plus rempli qu'au quart
+        int capacite = dernier->capacite;
+        if (capacite > CAPACITE_BLOC_MIN && dernier->nb - 1 <= capacite / 4) capacite /= 2;
+        nouveau_dernier = copier_bloc(dernier, capacite);
+        nouveau_dernier->nb = dernier->nb - 1;
+        nouveaux->blocs[indice_dernier] = nouveau_dernier;
+    }
+
+    if (place != derniere_place) {
+        size_t indice_bloc = place / TAILLE_BLOC_MEMBRES;
+        bloc_membres_t *cible = nouveau_dernier;
+        if (indice_bloc != (size_t)indice_dernier) {
+            cible = copier_bloc(anciens->blocs[indice_bloc], TAILLE_BLOC_MEMBRES);
+            nouveaux->blocs[indice_bloc] = cible;
+        }
+        cible->clients[place % TAILLE_BLOC_MEMBRES] = deplace;
+        roles_du_bloc(cible)[place % TAILLE_BLOC_MEMBRES] = role_deplace;
+        index_inserer(&partition->index_membres, deplace, place);
+    }
+    index_supprimer(&partition->index_membres, client);
+    publier_membres(partition, nouveaux);
+    return 1;
+}
+
+/**
+ * Change le rôle d'un membre (verrou du salon tenu) en recopiant son seul bloc
+ * @return 1 si le client est membre du salon
+ */
+static int modifier_role_membre(partition_salon_t *partition, client_t *client, int role) {
+    entree_index_t *entree = index_chercher(&partition->index_membres, client);
+    if (!entree) return 0;
+    instantane_salon_t *anciens = atomic_load_explicit(&partition->membres, memory_order_relaxed);
+    size_t indice_bloc = entree->valeur / TAILLE_BLOC_MEMBRES;
+    bloc_membres_t *source = anciens->blocs[indice_bloc];
+    instantane_salon_t *nouveaux = copier_instantane(anciens, anciens->nb_blocs);
+    bloc_membres_t *bloc = copier_bloc(source, source->capacite);
+    roles_du_bloc(bloc)[entree->valeur % TAILLE_BLOC_MEMBRES] = (unsigned char)role;
+    nouveaux->blocs[indice_bloc] = bloc;
+    publier_membres(partition, nouveaux);
+    return 1;
+}
+
+static void historique_vider(historique_t *historique);
+static void relacher_titulaire(const char *jeton);
+
+/**
+ * Libère un salon dont plus rien ne référence
+ */
+static void liberer_salon(salon_t *salon) {
+    for (int p = 0; p < nb_partitions; p++) {
+        instantane_salon_t *membres = atomic_load(&salon->partitions[p].membres);
+        for (int i = 0; i < membres->nb_blocs; i++) {
+            liberer_bloc(membres->blocs[i]);
+        }
+        if (membres != &membres_vides) liberer_instantane(membres);
+        index_liberer(&salon->partitions[p].index_membres);
+    }
+    free(salon->partitions);
+    historique_vider(&salon->historique);
+    free(salon->bans.regles);
+    for (size_t i = 0; i < salon->roles_retenus.capacite; i++) {
+        if (salon->roles_retenus.entrees[i].cle) relacher_titulaire(salon->roles_retenus.entrees[i].cle);
+    }
+    index_liberer(&salon->roles_retenus);
+    pthread_mutex_destroy(&salon->verrou);
+    pool_rendre(&pool_salons, salon);
+}
+
+/**
+ * Prend une référence sur un salon (section de lecture)
+ */
+static salon_t *salon_prendre(salon_t *salon) {
+    atomic_fetch_add_explicit(&salon->references, 1, memory_order_relaxed);
+    return salon;
+}
+
+/**
+ * Rend une référence ; la dernière libère le salon. Celle du répertoire est
+ * rendue par rcu_retirer(), une fois qu'aucune section de lecture ne peut
+ * plus trouver le salon.
+ */
+static void salon_relacher(void *objet) {
+    salon_t *salon = objet;
+    if (atomic_fetch_sub_explicit(&salon->references, 1, memory_order_acq_rel) == 1) {
+        liberer_salon(salon);
+    }
+}
+
+/**
+ * Crée un nouveau salon ou retourne un salon existant (NULL si le nom est vide).
+ * Le salon retourné peut être détruit à tout moment : l'appelant doit être en
+ * section de lecture et revérifier salon->detruit sous le verrou du salon.
+ */
+salon_t *obtenir_ou_creer_salon(const char *nom_demande) {
+    char nom[MAX_NOM_SALON];
+    strncpy(nom, nom_demande, MAX_NOM_SALON - 1);
+    nom[MAX_NOM_SALON - 1] = '\0';
+    if (nom[0] == '\0') return NULL;
+
+    verrouiller(&verrou_salons);
+    salon_t *s = trouver_salon(nom);
+    if (s) {
+        pthread_mutex_unlock(&verrou_salons);
+        return s;
+    }
+    s = pool_allouer(&pool_salons);
+    strcpy(s->nom_salon, nom);
+    pthread_mutex_init(&s->verrou, NULL);
+    s->partitions = malloc((size_t)nb_partitions * sizeof(partition_salon_t));
+    if (!s->partitions) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int p = 0; p < nb_partitions; p++) {
+        atomic_init(&s->partitions[p].membres, &membres_vides);
+        index_initialiser(&s->partitions[p].index_membres, 0);
+        s->partitions[p].fin_fenetre_ns = 0;
+    }
+    s->nb_membres = 0;
+    s->detruit = 0;
+    s->nb_sessions = 0;
+    atomic_init(&s->references, 1);
+    pthread_mutex_init(&s->historique.verrou, NULL);
+    s->historique.messages = NULL;
+    s->historique.debut = s->historique.nb = s->historique.octets = 0;
+    s->historique.sequence_chassee = 0;
+    memset(&s->bans, 0, sizeof(liste_bans_t));
+    index_initialiser(&s->roles_retenus, 1);
+    atomic_init(&s->debit_prevu, 0);
+    liste_salons = reserver_place(liste_salons, nb_salons_total, &capacite_salons, sizeof(salon_t *));
+    s->indice_liste = nb_salons_total;
+    liste_salons[nb_salons_total++] = s;
+    index_inserer(&index_salons, s->nom_salon, (uintptr_t)s);
+    atomic_fetch_add_explicit(&version_salons, 1, memory_order_release);
+    pthread_mutex_unlock(&verrou_salons);
+    return s;
+}
+
+/**
+ * Retire un salon du répertoire s'il y figure encore
+ */
+static void retirer_salon_du_repertoire(salon_t *salon) {
+    verrouiller(&verrou_salons);
+    if (salon->indice_liste < nb_salons_total && liste_salons[salon->indice_liste] == salon) {
+        salon_t *dernier = liste_salons[--nb_salons_total];
+        liste_salons[salon->indice_liste] = dernier;
+        dernier->indice_liste = salon->indice_liste;
+        index_supprimer(&index_salons, salon->nom_salon);
+        atomic_fetch_add_explicit(&version_salons, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&verrou_salons);
+}
+
+/**
+ * Crée un message d'une seule référence contenant une copie des octets
+ */
+message_t *message_copier(const char *donnees, size_t longueur) {
+    message_t *message = malloc(sizeof(message_t) + longueur);
+    if (!message) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&message->references, 1);
+    atomic_init(&message->livraisons_restantes, 0);
+    message->recu_ns = 0;
+    message->sequence = 0;
+    message->longueur = longueur;
+    memcpy(message->texte, donnees, longueur);
+    return message;
+}
+
+/**
+ * Crée un message d'une seule référence, formaté et mesuré une seule fois
+ * (tronqué à MAX_LIGNE_DIFFUSEE octets)
+ */
+static message_t *message_formater_liste(const char *format, va_list arguments) {
+    char tampon[MAX_LIGNE_DIFFUSEE];
+    int longueur = vsnprintf(tampon, sizeof(tampon), format, arguments);
+    if (longueur < 0) longueur = 0;
+    if ((size_t)longueur >= sizeof(tampon)) longueur = sizeof(tampon) - 1;
+    return message_copier(tampon, (size_t)longueur);
+}
+
+message_t *message_formater(const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    message_t *message = message_formater_liste(format, arguments);
+    va_end(arguments);
+    return message;
+}
+
+static message_t *message_prendre(message_t *message) {
+    atomic_fetch_add_explicit(&message->references, 1, memory_order_relaxed);
+    return message;
+}
+
+/**
+ * Rend une référence ; la dernière libère le message
+ */
+void message_relacher(message_t *message) {
+    if (atomic_fetch_sub_explicit(&message->references, 1, memory_order_acq_rel) == 1) {
+        free(message);
+    }
+}
+
+/**
+ * Ajoute un message en queue de la file de sortie, dont elle prend une
+ * référence. deja_ecrit octets ont été écrits directement (file vide).
+ */
+static void file_ajouter(file_sortie_t *file, message_t *message, size_t deja_ecrit) {
+    if (file->nb_segments == file->capacite) {
+        size_t capacite = file->capacite ? file->capacite * 2 : 8;
+        segment_sortie_t *segments = malloc(capacite * sizeof(segment_sortie_t));
+        if (!segments) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        // Remise à plat du tableau circulaire
+        for (size_t i = 0; i < file->nb_segments; i++) {
+            segments[i] = file->segments[(file->tete + i) & (file->capacite - 1)];
+        }
+        free(file->segments);
+        file->segments = segments;
+        file->capacite = capacite;
+        file->tete = 0;
+    }
+    segment_sortie_t *segment = &file->segments[(file->tete + file->nb_segments) & (file->capacite - 1)];
+    segment->message = message;
+    if (file->nb_segments == 0) file->decalage = deja_ecrit;
+    file->nb_segments++;
+    file->octets += message->longueur - deja_ecrit;
+}
+
+/**
+ * Retire et libère le segment de tête (entièrement écrit ou abandonné)
+ */
+static void file_retirer_tete(file_sortie_t *file) {
+    segment_sortie_t *segment = &file->segments[file->tete];
+    file->octets -= segment->message->longueur - file->decalage;
+    message_relacher(segment->message);
+    file->tete = (file->tete + 1) & (file->capacite - 1);
+    file->nb_segments--;
+    file->decalage = 0;
+}
+
+/**
+ * Jette le plus ancien message encore intact. Un segment de tête entamé est
+ * conservé pour ne pas couper une ligne au milieu du flux.
+ * @return le nombre d'octets jetés (0 si rien ne peut l'être)
+ */
+static size_t file_jeter_plus_ancien(file_sortie_t *file) {
+    if (file->decalage == 0) {
+        if (file->nb_segments == 0) return 0;
+        size_t longueur = file->segments[file->tete].message->longueur;
+        file_retirer_tete(file);
+        return longueur;
+    }
+    if (file->nb_segments < 2) return 0;
+    // Le segment entamé prend la place du suivant, qui est jeté
+    size_t masque = file->capacite - 1;
+    segment_sortie_t *entame = &file->segments[file->tete];
+    segment_sortie_t *suivant = &file->segments[(file->tete + 1) & masque];
+    size_t longueur = suivant->message->longueur;
+    message_relacher(suivant->message);
+    *suivant = *entame;
+    file->tete = (file->tete + 1) & masque;
+    file->nb_segments--;
+    file->octets -= longueur;
+    return longueur;
+}
+
+/**
+ * Décrit les premiers segments d'une file pour writev()
+ * @return le nombre de morceaux remplis (au plus MAX_IOV)
+ */
+static int file_morceaux(const file_sortie_t *file, struct iovec *iov) {
+    int nb_iov = 0;
+    for (size_t i = 0; i < file->nb_segments && nb_iov < MAX_IOV; i++) {
+        segment_sortie_t *segment = &file->segments[(file->tete + i) & (file->capacite - 1)];
+        size_t debut = i == 0 ? file->decalage : 0;
+        iov[nb_iov].iov_base = segment->message->texte + debut;
+        iov[nb_iov].iov_len = segment->message->longueur - debut;
+        nb_iov++;
+    }
+    return nb_iov;
+}
+
+/**
+ * Retire de la file les octets écrits : les segments entiers, puis le début
+ * du suivant
+ */
+static void file_consommer(file_sortie_t *file, size_t ecrit) {
+    while (ecrit > 0) {
+        segment_sortie_t *segment = &file->segments[file->tete];
+        size_t reste = segment->message->longueur - file->decalage;
+        if (ecrit < reste) {
+            file->decalage += ecrit;
+            file->octets -= ecrit;
+            break;
+        }
+        ecrit -= reste;
+        file_retirer_tete(file);
+    }
+}
+
+/**
+ * Libère tout le contenu d'une file de sortie
+ */
+static void file_vider(file_sortie_t *file) {
+    while (file->nb_segments > 0) {
+        file_retirer_tete(file);
+    }
+    free(file->segments);
+    memset(file, 0, sizeof(file_sortie_t));
+}
+
+/**
+ * Comptabilise des octets perdus pour un client (verrou_sortie tenu)
+ */
+static void compter_octets_perdus(client_t *client, size_t octets) {
+    client->octets_perdus += octets;
+    atomic_fetch_add_explicit(&octets_perdus_total, octets, memory_order_relaxed);
+}
+
+/**
+ * Rend la connexion inutilisable et réveille le réacteur propriétaire, qui
+ * fera le ménage (verrou_sortie tenu)
+ */
+static void abandonner_sortie(client_t *client) {
+    client->en_erreur = 1;
+    file_vider(&client->sortie);
+    shutdown(client->descripteur, SHUT_RDWR);
+}
+
+/**
+ * Écrit autant que possible la file de sortie d'un client, plusieurs
+ * segments par appel à writev (verrou_sortie tenu)
+ * @return 0 si tout est écrit ou si la socket est pleine, -1 en cas d'erreur
+ */
+static int ecrire_sortie_en_attente(client_t *client) {
+    file_sortie_t *file = &client->sortie;
+    int socket_pleine = 0;
+    do {
+        // Client en retard revenu sous la moitié de la limite : on le prévient
+        if (client->en_retard && file->octets <= limite_file_sortie / 2) {
+            client->en_retard = 0;
+            file_ajouter(file, message_formater("*** Connexion trop lente : %lu octets de messages perdus.\n", client->octets_perdus), 0);
+        }
+
+        while (file->nb_segments > 0) {
+            struct iovec iov[MAX_IOV];
+            int nb_iov = file_morceaux(file, iov);
+            ssize_t n = writev(client->descripteur, iov, nb_iov);
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                socket_pleine = 1;
+                break;
+            }
+            if (n <= 0) {
+                abandonner_sortie(client);
+                return -1;
+            }
+
+            compter(STAT_OCTETS_ENVOYES, (uint64_t)n);
+            client->octets_ecrits += (size_t)n;
+            file_consommer(file, (size_t)n);
+        }
+    } while (!socket_pleine && client->en_retard);
+    return 0;
+}
+
+/**
+ * Vide la sortie d'un client quand sa socket redevient inscriptible
+ * @return -1 si la connexion est inutilisable
+ */
+int vider_sortie(client_t *client) {
+    verrouiller(&client->verrou_sortie);
+    int resultat = client->en_erreur ? -1 : ecrire_sortie_en_attente(client);
+    pthread_mutex_unlock(&client->verrou_sortie);
+    return resultat;
+}
+
+/**
+ * Applique la politique de débordement choisie quand longueur octets ne
+ * tiennent plus dans la file de sortie (verrou_sortie tenu)
+ * @return 1 si la place a été faite et les octets doivent rejoindre la file
+ */
+static int deborder(client_t *client, size_t longueur) {
+    file_sortie_t *file = &client->sortie;
+    switch (politique_debordement) {
+        case DEBORDEMENT_ANCIEN:
+            while (file->octets + longueur > limite_file_sortie) {
+                size_t jetes = file_jeter_plus_ancien(file);
+                if (jetes == 0) break;
+                compter_octets_perdus(client, jetes);
+            }
+            if (file->octets + longueur <= limite_file_sortie) return 1;
+            compter_octets_perdus(client, longueur);
+            return 0;
+
+        case DEBORDEMENT_RETARD:
+            client->en_retard = 1;
+            compter_octets_perdus(client, longueur);
+            return 0;
+
+        default:
+            compter_octets_perdus(client, longueur + file->octets);
+            atomic_fetch_add_explicit(&deconnexions_lenteur, 1, memory_order_relaxed);
+            printf(">>> %s déconnecté : file de sortie pleine (%zu octets)\n", client->pseudo, file->octets);
+            abandonner_sortie(client);
+            return 0;
+    }
+}
+
+/**
+ * Envoie des octets à un client.
+ * En mode réacteur l'appel ne bloque jamais : ce qui ne passe pas tout de suite
+ * rejoint une file bornée, écrite au prochain EPOLLOUT. En mode thread par
+ * connexion, l'écriture est bloquante comme avant.
+ * @param partage  message contenant les octets, mis en file par référence ;
+ *                 NULL pour en mettre une copie en file si besoin
+ */
+static void envoyer(client_t *client, message_t *partage, const char *donnees, size_t longueur) {
+    verrouiller(&client->verrou_sortie);
+    if (client->en_erreur) {
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return;
+    }
+
+    if (mode_thread_par_connexion) {
+        while (longueur > 0) {
+            ssize_t n = write(client->descripteur, donnees, longueur);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) { abandonner_sortie(client); break; }
+            compter(STAT_OCTETS_ENVOYES, (uint64_t)n);
+            client->octets_ecrits += (size_t)n;
+            donnees += n;
+            longueur -= (size_t)n;
+        }
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return;
+    }
+
+    // Un client en retard ne reçoit plus rien tant que sa file n'a pas désempli
+    if (client->en_retard) {
+        compter_octets_perdus(client, longueur);
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return;
+    }
+
+    // Rien en attente : on tente l'écriture directe
+    size_t ecrit = 0;
+    if (client->sortie.nb_segments == 0) {
+        while (ecrit < longueur) {
+            ssize_t n = write(client->descripteur, donnees + ecrit, longueur - ecrit);
+            if (n > 0) {
+                ecrit += (size_t)n;
+                compter(STAT_OCTETS_ENVOYES, (uint64_t)n);
+                client->octets_ecrits += (size_t)n;
+            } else if (n == -1 && errno == EINTR) {
+                continue;
+            } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                abandonner_sortie(client);
+                pthread_mutex_unlock(&client->verrou_sortie);
+                return;
+            }
+        }
+    }
+
+    // Le reste attend que la socket redevienne inscriptible
+    size_t reste = longueur - ecrit;
+    if (reste > 0 && (client->sortie.octets + reste <= limite_file_sortie || deborder(client, reste))) {
+        message_t *message = partage ? message_prendre(partage) : message_copier(donnees, longueur);
+        file_ajouter(&client->sortie, message, ecrit);
+    }
+    pthread_mutex_unlock(&client->verrou_sortie);
+}
+
+/**
+ * Envoie des octets à un client (copiés seulement s'ils doivent attendre)
+ */
+void envoyer_au_client(client_t *client, const char *donnees, size_t longueur) {
+    envoyer(client, NULL, donnees, longueur);
+}
+
+/**
+ * Envoie une chaîne terminée par '\0' à un client
+ */
+void envoyer_texte(client_t *client, const char *texte) {
+    envoyer(client, NULL, texte, strlen(texte));
+}
+
+/**
+ * Envoie un message partagé à un client, mis en file par référence
+ */
+void envoyer_message(client_t *client, message_t *message) {
+    compter(STAT_MESSAGES_ENVOYES, 1);
+    envoyer(client, message, message->texte, message->longueur);
+}
+
+/**
+ * Envoie plusieurs messages partagés d'un seul tenant : en mode réacteur ils
+ * rejoignent la file par référence puis partent ensemble dans un writev()
+ */
+void envoyer_messages(client_t *client, message_t **messages, size_t nb) {
+    compter(STAT_MESSAGES_ENVOYES, nb);
+    verrouiller(&client->verrou_sortie);
+    if (client->en_erreur) {
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return;
+    }
+
+    if (mode_thread_par_connexion) {
+        size_t premier = 0, decalage = 0;
+        while (premier < nb) {
+            struct iovec iov[MAX_IOV];
+            int nb_iov = 0;
+            for (size_t i = premier; i < nb && nb_iov < MAX_IOV; i++) {
+                size_t debut = i == premier ? decalage : 0;
+                iov[nb_iov].iov_base = messages[i]->texte + debut;
+                iov[nb_iov].iov_len = messages[i]->longueur - debut;
+                nb_iov++;
+            }
+            ssize_t n = writev(client->descripteur, iov, nb_iov);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) { abandonner_sortie(client); break; }
+            size_t ecrit = (size_t)n;
+            compter(STAT_OCTETS_ENVOYES, ecrit);
+            client->octets_ecrits += ecrit;
+            while (ecrit > 0) {
+                size_t reste = messages[premier]->longueur - decalage;
+                if (ecrit < reste) {
+                    decalage += ecrit;
+                    break;
+                }
+                ecrit -= reste;
+                premier++;
+                decalage = 0;
+            }
+        }
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return;
+    }
+
+    int file_vide = client->sortie.nb_segments == 0;
+    for (size_t i = 0; i < nb && !client->en_erreur; i++) {
+        size_t longueur = messages[i]->longueur;
+        if (client->en_retard) {
+            compter_octets_perdus(client, longueur);
+        } else if (client->sortie.octets + longueur <= limite_file_sortie || deborder(client, longueur)) {
+            file_ajouter(&client->sortie, message_prendre(messages[i]), 0);
+        }
+    }
+    // Une file déjà entamée attend EPOLLOUT, sinon on écrit tout de suite
+    if (file_vide && !client->en_erreur) ecrire_sortie_en_attente(client);
+    pthread_mutex_unlock(&client->verrou_sortie);
+}
+
+/*
+ * Regroupement des diffusions (-g). Dans un salon calme chaque ligne part
+ * tout de suite et ouvre une fenêtre ; celles qui arrivent avant sa fin sont
+ * mises en file par référence chez chaque membre, sans appel système, et
+ * partent ensemble dans un writev() à l'échéance. Le réacteur du membre est
+ * seul à différer et à écrire ces envois : aucun verrou de plus.
+ */
+
+/**
+ * Met un message en file sans l'écrire : il partira avec les suivants au
+ * prochain regroupement (thread du réacteur du client)
+ */
+static void differer_message(client_t *client, message_t *message) {
+    compter(STAT_MESSAGES_ENVOYES, 1);
+    compter(STAT_ENVOIS_DIFFERES, 1);
+    verrouiller(&client->verrou_sortie);
+    if (client->en_erreur) {
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return;
+    }
+    if (client->en_retard) {
+        compter_octets_perdus(client, message->longueur);
+    } else if (client->sortie.octets + message->longueur <= limite_file_sortie || deborder(client, message->longueur)) {
+        file_ajouter(&client->sortie, message_prendre(message), 0);
+    }
+    pthread_mutex_unlock(&client->verrou_sortie);
+
+    if (!client->differe) {
+        reacteur_t *reacteur = client->reacteur;
+        reacteur->differes = reserver_place(reacteur->differes, reacteur->nb_differes, &reacteur->capacite_differes, sizeof(client_t *));
+        client->differe = 1;
+        client->indice_differe = reacteur->nb_differes;
+        reacteur->differes[reacteur->nb_differes++] = client;
+    }
+}
+
+/**
+ * Retire un client qui se déconnecte des envois différés de son réacteur
+ */
+static void oublier_envoi_differe(client_t *client) {
+    if (!client->differe) return;
+    reacteur_t *reacteur = client->reacteur;
+    client_t *dernier = reacteur->differes[--reacteur->nb_differes];
+    reacteur->differes[client->indice_differe] = dernier;
+    dernier->indice_differe = client->indice_differe;
+    client->differe = 0;
+}
+
+/**
+ * Écrit les envois différés d'un réacteur, un writev() par client. Une
+ * écriture en échec ferme la socket (shutdown) : le réacteur verra EPOLLHUP.
+ */
+static void ecrire_envois_differes(reacteur_t *reacteur) {
+    while (reacteur->nb_differes > 0) {
+        client_t *client = reacteur->differes[--reacteur->nb_differes];
+        client->differe = 0;
+        vider_sortie(client);
+    }
+}
+
+/**
+ * Décide si une diffusion dans une partition du réacteur courant rejoint la
+ * fenêtre ouverte, dont l'échéance devient alors celle du réacteur si elle
+ * est plus proche
+ * @return 1 si la diffusion doit être différée, 0 si elle part tout de suite
+ */
+static int regrouper_diffusion(reacteur_t *reacteur, partition_salon_t *partition) {
+    uint64_t maintenant = horloge_ns();
+    if (maintenant >= partition->fin_fenetre_ns) {
+        partition->fin_fenetre_ns = maintenant + fenetre_groupement_ns;
+        return 0;
+    }
+    if (reacteur->nb_differes == 0 || partition->fin_fenetre_ns < reacteur->echeance_differes_ns) {
+        reacteur->echeance_differes_ns = partition->fin_fenetre_ns;
+    }
+    return 1;
+}
+
+/*
+ * Historique récent des salons : chaque salon garde par référence, sans copie,
+ * ses derniers messages dans un anneau borné en nombre (-H) et en octets (-O).
+ * Un salon sans message ne coûte rien ; l'anneau part avec le salon.
+ */
+
+/**
+ * Garde un message diffusé dans l'historique du salon, en chassant les plus
+ * anciens au-delà des bornes
+ */
+void historique_ajouter(salon_t *salon, message_t *message) {
+    if (capacite_historique == 0) return;
+    historique_t *historique = &salon->historique;
+    verrouiller(&historique->verrou);
+    if (!historique->messages) {
+        historique->messages = malloc(capacite_historique * sizeof(message_t *));
+        if (!historique->messages) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        atomic_fetch_add_explicit(&octets_historiques, capacite_historique * sizeof(message_t *), memory_order_relaxed);
+    }
+    size_t liberes = 0;
+    while (historique->nb > 0 && (historique->nb == capacite_historique ||
+                                  historique->octets + message->longueur > octets_historique_max)) {
+        message_t *ancien = historique->messages[historique->debut];
+        historique->octets -= ancien->longueur;
+        liberes += ancien->longueur;
+        if (ancien->sequence > historique->sequence_chassee) historique->sequence_chassee = ancien->sequence;
+        message_relacher(ancien);
+        historique->debut = (historique->debut + 1) % capacite_historique;
+        historique->nb--;
+    }
+    historique->messages[(historique->debut + historique->nb) % capacite_historique] = message_prendre(message);
+    historique->nb++;
+    historique->octets += message->longueur;
+    pthread_mutex_unlock(&historique->verrou);
+
+    atomic_fetch_add_explicit(&octets_historiques, message->longueur, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&octets_historiques, liberes, memory_order_relaxed);
+}
+
+/**
+ * Rend tous les messages d'un historique et son anneau (salon libéré)
+ */
+static void historique_vider(historique_t *historique) {
+    if (historique->messages) {
+        for (size_t i = 0; i < historique->nb; i++) {
+            message_relacher(historique->messages[(historique->debut + i) % capacite_historique]);
+        }
+        free(historique->messages);
+        atomic_fetch_sub_explicit(&octets_historiques, historique->octets + capacite_historique * sizeof(message_t *),
+                                  memory_order_relaxed);
+    }
+    pthread_mutex_destroy(&historique->verrou);
+}
+
+/**
+ * Rejoue au client les nb_demandes derniers messages d'un salon, précédés
+ * d'un en-tête, en une seule écriture (section de lecture)
+ * @return le nombre de messages rejoués
+ */
+size_t rejouer_historique(client_t *client, salon_t *salon, size_t nb_demandes) {
+    historique_t *historique = &salon->historique;
+    message_t **lot = NULL;
+    size_t nb = 0;
+
+    // Les références sont prises sous le verrou, l'envoi se fait sans lui
+    verrouiller(&historique->verrou);
+    if (nb_demandes > historique->nb) nb_demandes = historique->nb;
+    if (nb_demandes > 0) {
+        lot = malloc((nb_demandes + 1) * sizeof(message_t *));
+        if (!lot) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = historique->nb - nb_demandes; i < historique->nb; i++) {
+            lot[++nb] = message_prendre(historique->messages[(historique->debut + i) % capacite_historique]);
+        }
+    }
+    pthread_mutex_unlock(&historique->verrou);
+    if (nb == 0) return 0;
+
+    lot[0] = message_formater("--- %zu message(s) récent(s) dans %s ---\n", nb, salon->nom_salon);
+    envoyer_messages(client, lot, nb + 1);
+    for (size_t i = 0; i <= nb; i++) {
+        message_relacher(lot[i]);
+    }
+    free(lot);
+    return nb;
+}
+
+/*
+ * Journal de l'historique : les messages de salon sont ajoutés, sans verrou ni
+ * appel système, à une pile que le thread du journal vide par lots. Chaque lot
+ * est écrit en un seul write() ; fdatasync() est appelé au plus une fois par
+ * intervalle de durabilité (à chaque lot si l'intervalle est nul).
+ */
+
+/**
+ * Confie un message diffusé dans un salon au journal (section de lecture).
+ * Le message est gardé par référence, sans copie.
+ */
+void journal_ajouter(salon_t *salon, message_t *message) {
+    if (journal.descripteur < 0) return;
+    if (atomic_load_explicit(&journal.en_attente, memory_order_relaxed) >= MAX_JOURNAL_EN_ATTENTE) {
+        atomic_fetch_add_explicit(&journal.perdus, 1, memory_order_relaxed);
+        return;
+    }
+    entree_journal_t *entree = malloc(sizeof(entree_journal_t));
+    if (!entree) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_REALTIME, &entree->horodatage);
+    strcpy(entree->salon, salon->nom_salon);
+    entree->message = message_prendre(message);
+    atomic_fetch_add_explicit(&journal.en_attente, 1, memory_order_relaxed);
+
+    entree_journal_t *tete = atomic_load_explicit(&journal.pile, memory_order_relaxed);
+    do {
+        entree->suivant = tete;
+    } while (!atomic_compare_exchange_weak_explicit(&journal.pile, &tete, entree,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static uint64_t horloge_us(clockid_t horloge) {
+    struct timespec t;
+    clock_gettime(horloge, &t);
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)t.tv_nsec / 1000;
+}
+
+/**
+ * Écrit un lot d'entrées (dans l'ordre d'arrivée) en un seul write()
+ * @return le nombre d'entrées écrites
+ */
+static size_t journal_ecrire_lot(entree_journal_t *entrees, char **tampon, size_t *capacite) {
+    size_t longueur = 0, nb = 0;
+    uint64_t plus_ancienne = 0;
+    for (entree_journal_t *e = entrees; e; e = e->suivant) {
+        size_t taille = 64 + MAX_NOM_SALON + e->message->longueur;
+        if (longueur + taille > *capacite) {
+            *capacite = (longueur + taille) * 2;
+            *tampon = realloc(*tampon, *capacite);
+            if (!*tampon) {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+        struct tm date;
+        localtime_r(&e->horodatage.tv_sec, &date);
+        longueur += strftime(*tampon + longueur, 32, "[%Y-%m-%d %H:%M:%S] ", &date);
+        longueur += (size_t)sprintf(*tampon + longueur, "(%s) ", e->salon);
+        memcpy(*tampon + longueur, e->message->texte, e->message->longueur);
+        longueur += e->message->longueur;
+        if (!plus_ancienne) plus_ancienne = (uint64_t)e->horodatage.tv_sec * 1000000 + (uint64_t)e->horodatage.tv_nsec / 1000;
+        nb++;
+    }
+
+    uint64_t debut = horloge_us(CLOCK_MONOTONIC);
+    size_t ecrit = 0;
+    while (ecrit < longueur) {
+        ssize_t n = write(journal.descripteur, *tampon + ecrit, longueur - ecrit);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("write journal");
+            break;
+        }
+        ecrit += (size_t)n;
+    }
+    uint64_t fin = horloge_us(CLOCK_MONOTONIC);
+
+    journal.nb_lots++;
+    journal.duree_ecriture_us += fin - debut;
+    if (fin - debut > journal.duree_ecriture_max_us) journal.duree_ecriture_max_us = fin - debut;
+    // Attente de la plus ancienne entrée du lot, de son dépôt à son écriture
+    uint64_t attente = horloge_us(CLOCK_REALTIME) - plus_ancienne;
+    if (attente > journal.attente_max_us) journal.attente_max_us = attente;
+    return nb;
+}
+
+/**
+ * Thread du journal : relève la pile à intervalle fixe et écrit chaque lot
+ */
+static void *boucle_journal(void *arg) {
+    (void)arg;
+    char *tampon = NULL;
+    size_t capacite = 0;
+    uint64_t dernier_fdatasync = horloge_us(CLOCK_MONOTONIC);
+    uint64_t derniere_synthese = dernier_fdatasync;
+    int a_synchroniser = 0;
+
+    for (;;) {
+        struct timespec pause_lot = { 0, INTERVALLE_LOT_MS * 1000000L };
+        nanosleep(&pause_lot, NULL);
+
+        // La pile entière est prise d'un coup, puis remise dans l'ordre d'arrivée
+        entree_journal_t *pile = atomic_exchange_explicit(&journal.pile, NULL, memory_order_acquire);
+        entree_journal_t *entrees = NULL;
+        while (pile) {
+            entree_journal_t *suivant = pile->suivant;
+            pile->suivant = entrees;
+            entrees = pile;
+            pile = suivant;
+        }
+
+        if (entrees) {
+            size_t nb = journal_ecrire_lot(entrees, &tampon, &capacite);
+            journal.nb_ecrits += nb;
+            atomic_fetch_sub_explicit(&journal.en_attente, nb, memory_order_relaxed);
+            while (entrees) {
+                entree_journal_t *suivant = entrees->suivant;
+                message_relacher(entrees->message);
+                free(entrees);
+                entrees = suivant;
+            }
+            a_synchroniser = 1;
+        }
+
+        uint64_t maintenant = horloge_us(CLOCK_MONOTONIC);
+        if (a_synchroniser && maintenant - dernier_fdatasync >= (uint64_t)journal.intervalle_durabilite_ms * 1000) {
+            fdatasync(journal.descripteur);
+            journal.nb_fdatasync++;
+            dernier_fdatasync = horloge_us(CLOCK_MONOTONIC);
+            journal.duree_fdatasync_us += dernier_fdatasync - maintenant;
+            a_synchroniser = 0;
+        }
+
+        if (maintenant - derniere_synthese >= INTERVALLE_SYNTHESE_JOURNAL_S * 1000000ULL && journal.nb_lots > 0) {
+            derniere_synthese = maintenant;
+            printf(">>> Journal : %lu messages en %lu lots, écriture moyenne %lu µs (max %lu µs), "
+                   "%lu fdatasync, attente max %lu µs, %lu en attente, %lu perdus\n",
+                   journal.nb_ecrits, journal.nb_lots, journal.duree_ecriture_us / journal.nb_lots,
+                   journal.duree_ecriture_max_us, journal.nb_fdatasync, journal.attente_max_us,
+                   (unsigned long)atomic_load(&journal.en_attente), (unsigned long)atomic_load(&journal.perdus));
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Ouvre le fichier d'historique en ajout et démarre le thread du journal
+ */
+void demarrer_journal(const char *chemin) {
+    journal.descripteur = open(chemin, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (journal.descripteur == -1) {
+        perror(chemin);
+        exit(EXIT_FAILURE);
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, boucle_journal, NULL) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(thread);
+}
+
+/**
+ * Attend que le thread du journal ait écrit tout ce qui y a été déposé (fin
+ * d'un rejeu)
+ */
+void attendre_journal(void) {
+    struct timespec pause_lot = { 0, INTERVALLE_LOT_MS * 1000000L };
+    while (atomic_load(&journal.en_attente) > 0) nanosleep(&pause_lot, NULL);
+    fdatasync(journal.descripteur);
+}
+
+/**
+ * Livre un message aux membres d'une partition, sans verrou : la liste
+ * parcourue est celle publiée au moment de l'appel (section de lecture).
+ * Appelée par un réacteur, la partition est la sienne et peut regrouper.
+ */
+static void livrer_dans_partition(partition_salon_t *partition, message_t *message, client_t *client_exclu) {
+    instantane_salon_t *membres = atomic_load_explicit(&partition->membres, memory_order_acquire);
+    int differer = fenetre_groupement_ns && reacteur_courant && membres->nb_clients > 0 &&
+                   regrouper_diffusion(reacteur_courant, partition);
+    for (int b = 0; b < membres->nb_blocs; b++) {
+        bloc_membres_t *bloc = membres->blocs[b];
+        for (int i = 0; i < bloc->nb; i++) {
+            if (bloc->clients[i] == client_exclu) continue;
+            if (differer) differer_message(bloc->clients[i], message);
+            else envoyer_message(bloc->clients[i], message);
+        }
+    }
+}
+
+/**
+ * Dépose une diffusion dans la boîte aux lettres d'un réacteur (section de
+ * lecture). Le dépôt est sans verrou ; le réacteur n'est réveillé que si sa
+ * boîte était vide, les courriers suivants profitent du même réveil.
+ */
+static void poster_courrier(reacteur_t *reacteur, salon_t *salon, message_t *message, client_t *client_exclu) {
+    courrier_t *courrier = malloc(sizeof(courrier_t));
+    if (!courrier) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    courrier->salon = salon_prendre(salon);
+    courrier->message = message_prendre(message);
+    courrier->client_exclu = client_exclu;
+
+    courrier_t *tete = atomic_load_explicit(&reacteur->boite, memory_order_relaxed);
+    do {
+        courrier->suivant = tete;
+    } while (!atomic_compare_exchange_weak_explicit(&reacteur->boite, &tete, courrier,
+                                                    memory_order_release, memory_order_relaxed));
+    if (!tete) {
+        uint64_t un = 1;
+        if (write(reacteur->reveil, &un, sizeof(un)) == -1 && errno != EAGAIN) perror("write eventfd");
+    }
+}
+
+/**
+ * Marque une partition servie ; la dernière mesure la diffusion, de la lecture
+ * de la ligne d'origine à l'écriture (ou mise en file) au dernier destinataire
+ */
+static void terminer_livraison(message_t *message) {
+    if (atomic_fetch_sub_explicit(&message->livraisons_restantes, 1, memory_order_acq_rel) == 1) {
+        mesurer(&obtenir_statistiques()->latence_diffusion, horloge_ns() - message->recu_ns);
+    }
+}
+
+/**
+ * Diffuse un message à tous les membres d'un salon (section de lecture).
+ * Chaque réacteur sert lui-même ses membres : la partition du réacteur
+ * appelant est servie tout de suite, les autres reçoivent un courrier et la
+ * servent en parallèle. Le message n'est jamais recopié : chaque file de
+ * sortie en prend une référence.
+ * @param salon         Le salon cible
+ * @param message       Le message à envoyer
+ * @param client_exclu  Client à exclure (NULL pour tous)
+ */
+void diffuser_message_dans_salon(salon_t *salon, message_t *message, client_t *client_exclu) {
+    // Une diffusion mesurée compte l'appelant comme une livraison en cours
+    int mesuree = message->recu_ns != 0;
+    if (mesuree) atomic_store_explicit(&message->livraisons_restantes, 1, memory_order_relaxed);
+    for (int p = 0; p < nb_partitions; p++) {
+        partition_salon_t *partition = &salon->partitions[p];
+        if (atomic_load_explicit(&partition->membres, memory_order_acquire)->nb_clients == 0) continue;
+        if (nb_partitions == 1 || reacteur_courant == &liste_reacteurs[p]) {
+            livrer_dans_partition(partition, message, client_exclu);
+        } else {
+            if (mesuree) atomic_fetch_add_explicit(&message->livraisons_restantes, 1, memory_order_relaxed);
+            poster_courrier(&liste_reacteurs[p], salon, message, client_exclu);
+        }
+    }
+    if (mesuree) terminer_livraison(message);
+}
+
+/**
+ * Formate une fois un message et le diffuse dans un salon (section de lecture)
+ */
+void diffuser_dans_salon(salon_t *salon, client_t *client_exclu, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    message_t *message = message_formater_liste(format, arguments);
+    va_end(arguments);
+    diffuser_message_dans_salon(salon, message, client_exclu);
+    message_relacher(message);
+}
+
+/*
+ * Fédération (-F, -L). Plusieurs instances forment une grappe maillée : chaque
+ * nœud a un lien TCP avec chacun des autres. Une diffusion est relayée une
+ * fois sur chaque lien par le nœud d'origine, puis livrée par chaque nœud à ses
+ * propres membres du salon de même nom ; rien n'est retransmis. Chaque nœud
+ * annonce ses pseudos, que les autres refusent à l'inscription. Un lien n'est
+ * établi que si le pair présente dans son BONJOUR le secret partagé (-K) :
+ * sans lui, un hôte qui joint le port -F pourrait évincer des pseudos locaux
+ * ou parler sous n'importe quel nom. Le secret circule en clair, la grappe
+ * doit donc être reliée par un réseau de confiance.
+ *
+ * Trames : longueur (32 bits, ordre du réseau, type compris), type, charge.
+ *   BONJOUR       version (32 bits), identifiant du nœud (64 bits), secret
+ *   PSEUDO_PRIS   pseudo            PSEUDO_LIBRE  pseudo
+ *   LIGNE, AVIS   longueur du nom du salon (8 bits), nom, texte à livrer
+ * Une LIGNE rejoint aussi l'historique du salon, un AVIS (arrivées, départs)
+ * non.
+ */
+
+// Lien avec un autre nœud de la grappe (fédération). Les threads qui diffusent
+// y déposent des trames ; le thread de fédération les écrit, lit celles du
+// pair et ferme le lien.
+typedef struct lien {
+    int descripteur;
+    int pair;                       // indice dans pairs si nous l'avons ouvert (-L), -1 sinon
+    int connecte;                   // connect() non bloquant terminé
+    uint64_t identifiant_pair;      // 0 jusqu'à la trame BONJOUR du pair
+    pthread_mutex_t verrou;         // protège sortie et en_erreur
+    file_sortie_t sortie;           // trames en attente d'écriture
+    int en_erreur;                  // file trop longue : fermeture au prochain tour
+    texte_t entree;                 // octets reçus, dernière trame incomplète
+} lien_t;
+
+// Liens établis (BONJOUR échangé), publiés par RCU pour les diffusions
+typedef struct liste_liens {
+    size_t nb;
+    lien_t *liens[];
+} liste_liens_t;
+
+// Fédération : identifiant tiré au démarrage (gardé au redémarrage à chaud),
+// liens établis et pseudos tenus par les autres nœuds
+static uint64_t identifiant_noeud = 0;
+static liste_liens_t aucun_lien = { 0 };
+static _Atomic(liste_liens_t *) liens_etablis = &aucun_lien;
+static index_t index_pseudos_distants;     // pseudo (copie) -> lien du nœud qui le tient (sous verrou_clients)
+static int reveil_federation = -1;         // eventfd du thread de fédération
+
+enum { TRAME_BONJOUR = 1, TRAME_PSEUDO_PRIS, TRAME_PSEUDO_LIBRE, TRAME_LIGNE, TRAME_AVIS };
+
+/**
+ * Construit une trame dont la charge est faite de deux morceaux bout à bout
+ * @return un message d'une seule référence, à déposer sur les liens
+ */
+static message_t *trame_construire(int type, const void *debut, size_t longueur_debut, const void *suite, size_t longueur_suite) {
+    char tampon[MAX_TRAME];
+    if (longueur_debut + longueur_suite > MAX_TRAME - 5) longueur_suite = MAX_TRAME - 5 - longueur_debut;
+    uint32_t longueur = htonl((uint32_t)(1 + longueur_debut + longueur_suite));
+    memcpy(tampon, &longueur, 4);
+    tampon[4] = (char)type;
+    memcpy(tampon + 5, debut, longueur_debut);
+    if (longueur_suite) memcpy(tampon + 5 + longueur_debut, suite, longueur_suite);
+    return message_copier(tampon, 5 + longueur_debut + longueur_suite);
+}
+
+/**
+ * Dépose une trame sur un lien, par référence. Le thread de fédération n'est
+ * réveillé que si la file était vide ; une file trop longue condamne le lien,
+ * qui sera rétabli et resynchronisé.
+ */
+static void lien_deposer(lien_t *lien, message_t *trame) {
+    verrouiller(&lien->verrou);
+    int reveiller = lien->sortie.nb_segments == 0;
+    if (lien->en_erreur) {
+        reveiller = 0;
+    } else if (lien->sortie.octets + trame->longueur > LIMITE_SORTIE_LIEN) {
+        lien->en_erreur = reveiller = 1;
+    } else {
+        file_ajouter(&lien->sortie, message_prendre(trame), 0);
+    }
+    pthread_mutex_unlock(&lien->verrou);
+    if (reveiller) {
+        uint64_t un = 1;
+        if (write(reveil_federation, &un, sizeof(un)) == -1 && errno != EAGAIN) perror("write eventfd");
+    }
+}
+
+/**
+ * Dépose une trame sur tous les liens établis (section de lecture)
+ */
+static void relayer_trame(message_t *trame) {
+    liste_liens_t *liens = atomic_load_explicit(&liens_etablis, memory_order_acquire);
+    for (size_t i = 0; i < liens->nb; i++) lien_deposer(liens->liens[i], trame);
+}
+
+/**
+ * Relaie une diffusion locale aux autres nœuds (section de lecture)
+ * @param type  TRAME_LIGNE ou TRAME_AVIS
+ */
+static void relayer_diffusion(salon_t *salon, message_t *message, int type) {
+    if (atomic_load_explicit(&liens_etablis, memory_order_acquire)->nb == 0) return;
+    char entete[1 + MAX_NOM_SALON];
+    size_t longueur_nom = strlen(salon->nom_salon);
+    entete[0] = (char)longueur_nom;
+    memcpy(entete + 1, salon->nom_salon, longueur_nom);
+    message_t *trame = trame_construire(type, entete, 1 + longueur_nom, message->texte, message->longueur);
+    relayer_trame(trame);
+    message_relacher(trame);
+}
+
+/**
+ * Annonce aux autres nœuds qu'un pseudo est pris ou libéré (verrou_clients
+ * tenu : les annonces d'un même pseudo partent dans l'ordre des inscriptions)
+ */
+static void annoncer_pseudo(int type, const char *pseudo) {
+    rcu_lire_debut();
+    if (atomic_load_explicit(&liens_etablis, memory_order_acquire)->nb > 0) {
+        message_t *trame = trame_construire(type, pseudo, strlen(pseudo), NULL, 0);
+        relayer_trame(trame);
+        message_relacher(trame);
+    }
+    rcu_lire_fin();
+}
+
+/**
+ * Formate une fois un avis, le diffuse dans un salon et le relaie aux autres
+ * nœuds (section de lecture)
+ */
+static void diffuser_avis(salon_t *salon, client_t *client_exclu, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    message_t *message = message_formater_liste(format, arguments);
+    va_end(arguments);
+    diffuser_message_dans_salon(salon, message, client_exclu);
+    relayer_diffusion(salon, message, TRAME_AVIS);
+    message_relacher(message);
+}
+
+/*
+ * Bannissements. Chaque salon a sa liste, consultée à l'arrivée d'un membre.
+ * Ceux du serveur (fichier -b, socket d'administration) sont vérifiés à
+ * l'inscription pour les pseudos et, pour les adresses, juste après accept() :
+ * les préfixes bannis forment un arbre binaire compact, reconstruit à chaque
+ * changement et publié par RCU, que la connexion refusée parcourt sur au plus
+ * 32 nœuds sans verrou ni allocation.
+ */
+
+// Nœud de l'arbre des préfixes : un fils par valeur du bit suivant
+typedef struct noeud_prefixe {
+    uint32_t enfants[2];        // indices dans noeuds, 0 : aucun (la racine n'est fille de personne)
+    int64_t expiration;         // -1 : aucun préfixe banni ici, 0 : définitif
+} noeud_prefixe_t;
+
+typedef struct arbre_prefixes {
+    size_t nb;
+    size_t capacite;
+    noeud_prefixe_t noeuds[];
+} arbre_prefixes_t;
+
+static liste_bans_t bans_serveur;
+static pthread_mutex_t verrou_bans = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(arbre_prefixes_t *) prefixes_bannis = NULL;
+
+/**
+ * Lit une cible de bannissement : adresse IPv4, éventuellement suivie de
+ * /longueur, ou pseudo. Une durée nulle rend le bannissement définitif.
+ * @return 0, ou -1 si la cible est invalide
+ */
+static int analyser_regle(const char *cible, long minutes, regle_ban_t *regle) {
+    memset(regle, 0, sizeof(regle_ban_t));
+    regle->expiration = minutes > 0 ? time(NULL) + minutes * 60 : 0;
+
+    char adresse[INET_ADDRSTRLEN];
+    const char *barre = strchr(cible, '/');
+    size_t longueur = barre ? (size_t)(barre - cible) : strlen(cible);
+    struct in_addr ipv4;
+    if (longueur < sizeof(adresse)) {
+        memcpy(adresse, cible, longueur);
+        adresse[longueur] = '\0';
+        if (inet_pton(AF_INET, adresse, &ipv4) == 1) {
+            char *fin;
+            long prefixe = barre ? strtol(barre + 1, &fin, 10) : 32;
+            if (barre && (fin == barre + 1 || *fin != '\0' || prefixe < 0 || prefixe > 32)) return -1;
+            regle->par_adresse = 1;
+            regle->longueur_prefixe = (int)prefixe;
+            uint32_t masque = prefixe ? ~(uint32_t)0 << (32 - prefixe) : 0;
+            regle->reseau = ntohl(ipv4.s_addr) & masque;
+            return 0;
+        }
+    }
+    if (barre || cible[0] == '\0' || strlen(cible) >= MAX_PSEUDO || strchr(cible, ' ')) return -1;
+    strcpy(regle->pseudo, cible);
+    return 0;
+}
+
+static int meme_cible(const regle_ban_t *a, const regle_ban_t *b) {
+    if (a->par_adresse != b->par_adresse) return 0;
+    if (a->par_adresse) return a->reseau == b->reseau && a->longueur_prefixe == b->longueur_prefixe;
+    return strcmp(a->pseudo, b->pseudo) == 0;
+}
+
+static int regle_expiree(const regle_ban_t *regle, time_t maintenant) {
+    return regle->expiration != 0 && regle->expiration <= maintenant;
+}
+
+static int regle_vise(const regle_ban_t *regle, const char *pseudo, uint32_t adresse) {
+    if (!regle->par_adresse) return pseudo && strcmp(regle->pseudo, pseudo) == 0;
+    uint32_t masque = regle->longueur_prefixe ? ~(uint32_t)0 << (32 - regle->longueur_prefixe) : 0;
+    return (adresse & masque) == regle->reseau;
+}
+
+/**
+ * Ajoute une règle (ou prolonge celle qui vise déjà la même cible), en
+ * oubliant au passage les règles expirées
+ */
+static void liste_bans_ajouter(liste_bans_t *liste, const regle_ban_t *regle) {
+    time_t maintenant = time(NULL);
+    size_t garde = 0;
+    for (size_t i = 0; i < liste->nb; i++) {
+        if (!regle_expiree(&liste->regles[i], maintenant) && !meme_cible(&liste->regles[i], regle)) {
+            liste->regles[garde++] = liste->regles[i];
+        }
+    }
+    liste->nb = garde;
+    liste->regles = reserver_place(liste->regles, liste->nb, &liste->capacite, sizeof(regle_ban_t));
+    liste->regles[liste->nb++] = *regle;
+}
+
+/**
+ * @return le nombre de règles retirées
+ */
+static size_t liste_bans_retirer(liste_bans_t *liste, const regle_ban_t *regle) {
+    size_t garde = 0;
+    for (size_t i = 0; i < liste->nb; i++) {
+        if (!meme_cible(&liste->regles[i], regle)) liste->regles[garde++] = liste->regles[i];
+    }
+    size_t retirees = liste->nb - garde;
+    liste->nb = garde;
+    return retirees;
+}
+
+/**
+ * @return 1 si une règle encore valide vise ce pseudo ou cette adresse
+ */
+static int liste_bans_vise(const liste_bans_t *liste, const char *pseudo, uint32_t adresse) {
+    if (liste->nb == 0) return 0;
+    time_t maintenant = time(NULL);
+    for (size_t i = 0; i < liste->nb; i++) {
+        if (!regle_expiree(&liste->regles[i], maintenant) && regle_vise(&liste->regles[i], pseudo, adresse)) return 1;
+    }
+    return 0;
+}
+
+static void liste_bans_decrire(const liste_bans_t *liste, texte_t *texte) {
+    time_t maintenant = time(NULL);
+    for (size_t i = 0; i < liste->nb; i++) {
+        const regle_ban_t *regle = &liste->regles[i];
+        if (regle_expiree(regle, maintenant)) continue;
+        if (regle->par_adresse) {
+            struct in_addr ipv4 = { htonl(regle->reseau) };
+            char adresse[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &ipv4, adresse, sizeof(adresse));
+            texte_ajouter(texte, "- %s/%d", adresse, regle->longueur_prefixe);
+        } else {
+            texte_ajouter(texte, "- %s", regle->pseudo);
+        }
+        if (regle->expiration) texte_ajouter(texte, " (encore %ld min)\n", (long)(regle->expiration - maintenant + 59) / 60);
+        else texte_ajouter(texte, " (définitif)\n");
+    }
+}
+
+static uint32_t arbre_nouveau_noeud(arbre_prefixes_t **arbre) {
+    if ((*arbre)->nb == (*arbre)->capacite) {
+        (*arbre)->capacite *= 2;
+        *arbre = realloc(*arbre, sizeof(arbre_prefixes_t) + (*arbre)->capacite * sizeof(noeud_prefixe_t));
+        if (!*arbre) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    noeud_prefixe_t *noeud = &(*arbre)->noeuds[(*arbre)->nb];
+    noeud->enfants[0] = noeud->enfants[1] = 0;
+    noeud->expiration = -1;
+    return (uint32_t)(*arbre)->nb++;
+}
+
+/**
+ * Reconstruit et publie l'arbre des préfixes bannis du serveur (verrou_bans
+ * tenu) ; l'ancien est libéré quand plus aucun accept() ne le parcourt
+ */
+static void publier_prefixes_bannis(void) {
+    time_t maintenant = time(NULL);
+    arbre_prefixes_t *arbre = NULL;
+    for (size_t i = 0; i < bans_serveur.nb; i++) {
+        const regle_ban_t *regle = &bans_serveur.regles[i];
+        if (!regle->par_adresse || regle_expiree(regle, maintenant)) continue;
+        if (!arbre) {
+            arbre = malloc(sizeof(arbre_prefixes_t) + 64 * sizeof(noeud_prefixe_t));
+            if (!arbre) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
+            }
+            arbre->nb = 0;
+            arbre->capacite = 64;
+            arbre_nouveau_noeud(&arbre);
+        }
+        uint32_t n = 0;
+        for (int bit = 31; bit >= 32 - regle->longueur_prefixe; bit--) {
+            int cote = (regle->reseau >> bit) & 1;
+            if (!arbre->noeuds[n].enfants[cote]) {
+                uint32_t enfant = arbre_nouveau_noeud(&arbre);
+                arbre->noeuds[n].enfants[cote] = enfant;
+            }
+            n = arbre->noeuds[n].enfants[cote];
+        }
+        // Deux règles sur le même préfixe : la plus longue l'emporte
+        int64_t *expiration = &arbre->noeuds[n].expiration;
+        if (*expiration == -1 || (*expiration != 0 && (regle->expiration == 0 || regle->expiration > *expiration))) {
+            *expiration = regle->expiration;
+        }
+    }
+    arbre_prefixes_t *ancien = atomic_exchange_explicit(&prefixes_bannis, arbre, memory_order_acq_rel);
+    if (ancien) rcu_retirer(ancien, free);
+}
+
+/**
+ * Vérifie une adresse qui vient de se connecter : sans aucun préfixe banni,
+ * un seul chargement atomique
+ * @return 1 si la connexion doit être refusée
+ */
+int adresse_bannie(uint32_t adresse) {
+    if (!atomic_load_explicit(&prefixes_bannis, memory_order_relaxed)) return 0;
+    int bannie = 0;
+    rcu_lire_debut();
+    const arbre_prefixes_t *arbre = atomic_load_explicit(&prefixes_bannis, memory_order_acquire);
+    uint32_t n = 0;
+    for (int bit = 31; arbre; bit--) {
+        int64_t expiration = arbre->noeuds[n].expiration;
+        if (expiration == 0 || (expiration > 0 && expiration > (int64_t)time(NULL))) {
+            bannie = 1;
+            break;
+        }
+        if (bit < 0 || !(n = arbre->noeuds[n].enfants[(adresse >> bit) & 1])) break;
+    }
+    rcu_lire_fin();
+    return bannie;
+}
+
+/**
+ * Bannit (ou débannit) une cible de tout le serveur ; les connexions
+ * qu'elle vise sont fermées
+ * @return 0, ou -1 si la cible est invalide ou, pour un débannissement, inconnue
+ */
+int modifier_ban_serveur(const char *cible, long minutes, int retirer) {
+    regle_ban_t regle;
+    if (analyser_regle(cible, minutes, &regle) < 0) return -1;
+
+    verrouiller(&verrou_bans);
+    size_t retirees = 0;
+    if (retirer) retirees = liste_bans_retirer(&bans_serveur, &regle);
+    else liste_bans_ajouter(&bans_serveur, &regle);
+    if (regle.par_adresse) publier_prefixes_bannis();
+    pthread_mutex_unlock(&verrou_bans);
+    atomic_fetch_add_explicit(&version_persistante, 1, memory_order_relaxed);
+    if (retirer) return retirees ? 0 : -1;
+
+    // Les clients visés sont relevés sous le verrou, prévenus et coupés hors de lui
+    rcu_lire_debut();
+    client_t **vises = NULL;
+    size_t nb_vises = 0, capacite_vises = 0;
+    verrouiller(&verrou_clients);
+    for (size_t i = 0; i < nb_clients_total; i++) {
+        if (regle_vise(&regle, liste_clients[i]->pseudo, liste_clients[i]->adresse)) {
+            vises = reserver_place(vises, nb_vises, &capacite_vises, sizeof(client_t *));
+            vises[nb_vises++] = liste_clients[i];
+        }
+    }
+    pthread_mutex_unlock(&verrou_clients);
+    for (size_t i = 0; i < nb_vises; i++) {
+        envoyer_texte(vises[i], "Vous êtes banni du serveur.\n");
+        verrouiller(&vises[i]->verrou_sortie);
+        vises[i]->sans_reprise = 1;
+        if (!vises[i]->en_erreur) abandonner_sortie(vises[i]);
+        pthread_mutex_unlock(&vises[i]->verrou_sortie);
+    }
+    rcu_lire_fin();
+    free(vises);
+    return 0;
+}
+
+/**
+ * Charge les bannissements du serveur depuis un fichier : une cible par
+ * ligne, suivie d'une durée en minutes facultative ; # commence un commentaire
+ */
+void charger_bans(const char *chemin) {
+    FILE *fichier = fopen(chemin, "r");
+    if (!fichier) {
+        perror(chemin);
+        exit(EXIT_FAILURE);
+    }
+    char ligne[256];
+    int numero = 0, nb = 0;
+    while (fgets(ligne, sizeof(ligne), fichier)) {
+        numero++;
+        ligne[strcspn(ligne, "#\r\n")] = '\0';
+        char *cible = strtok(ligne, " \t");
+        if (!cible) continue;
+        char *duree = strtok(NULL, " \t");
+        if (modifier_ban_serveur(cible, duree ? atol(duree) : 0, 0) < 0) {
+            fprintf(stderr, "%s:%d : cible invalide %s\n", chemin, numero, cible);
+            continue;
+        }
+        nb++;
+    }
+    fclose(fichier);
+    printf(">>> %d bannissement(s) chargé(s) depuis %s\n", nb, chemin);
+}
+
+/**
+ * Vérifie à l'inscription un pseudo et l'adresse d'où il vient (une adresse
+ * bannie depuis la connexion n'a pas encore été refusée)
+ * @return 1 si l'un des deux est banni du serveur
+ */
+static int banni_du_serveur(const char *pseudo, uint32_t adresse) {
+    verrouiller(&verrou_bans);
+    int banni = liste_bans_vise(&bans_serveur, pseudo, adresse);
+    pthread_mutex_unlock(&verrou_bans);
+    return banni;
+}
+
+/*
+ * Rôles retenus. Un rôle de salon n'est pas rendu à un pseudo, que n'importe
+ * qui peut reprendre, mais au titulaire d'un jeton de reprise : le client qui
+ * l'a reçu à son inscription, qui le garde en reprenant sa session et, après
+ * un redémarrage sur cliché, en le présentant de nouveau. Le titulaire est
+ * oublié, avec tous ses rôles, quand son pseudo est libéré : /exit, connexion
+ * coupée sans session ou session expirée. Sans jeton (-s 0), un rôle ne dure
+ * que le temps de la connexion.
+ */
+
+// Titulaire de rôles retenus, désigné par son jeton (sous verrou_titulaires)
+typedef struct titulaire {
+    char jeton[2 * TAILLE_JETON + 1];   // clé des rôles retenus dans les salons
+    char pseudo[MAX_PSEUDO];            // rendu par une reprise après redémarrage
+    size_t nb_roles;
+} titulaire_t;
+
+static index_t index_titulaires;            // jeton -> titulaire
+static pthread_mutex_t verrou_titulaires = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Compte un rôle de plus à un titulaire, créé au besoin
+ * @return le jeton du titulaire, qui sert de clé tant qu'il a des rôles
+ */
+static const char *prendre_titulaire(const char *jeton, const char *pseudo) {
+    verrouiller(&verrou_titulaires);
+    entree_index_t *entree = index_chercher(&index_titulaires, jeton);
+    titulaire_t *titulaire;
+    if (entree) {
+        titulaire = (titulaire_t *)entree->valeur;
+    } else {
+        titulaire = malloc(sizeof(titulaire_t));
+        if (!titulaire) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(titulaire->jeton, sizeof(titulaire->jeton), "%s", jeton);
+        snprintf(titulaire->pseudo, sizeof(titulaire->pseudo), "%s", pseudo);
+        titulaire->nb_roles = 0;
+        index_inserer(&index_titulaires, titulaire->jeton, (uintptr_t)titulaire);
+    }
+    titulaire->nb_roles++;
+    pthread_mutex_unlock(&verrou_titulaires);
+    return titulaire->jeton;
+}
+
+/**
+ * Décompte un rôle d'un titulaire, libéré avec le dernier
+ */
+static void relacher_titulaire(const char *jeton) {
+    verrouiller(&verrou_titulaires);
+    entree_index_t *entree = index_chercher(&index_titulaires, jeton);
+    titulaire_t *titulaire = (titulaire_t *)entree->valeur;
+    if (--titulaire->nb_roles == 0) {
+        index_supprimer(&index_titulaires, titulaire->jeton);
+        free(titulaire);
+    }
+    pthread_mutex_unlock(&verrou_titulaires);
+}
+
+/**
+ * Recopie le pseudo du titulaire d'un jeton
+ * @return 1 si le jeton a des rôles retenus, 0 sinon
+ */
+static int pseudo_du_titulaire(const char *jeton, char *pseudo) {
+    verrouiller(&verrou_titulaires);
+    entree_index_t *entree = index_chercher(&index_titulaires, jeton);
+    if (entree) strcpy(pseudo, ((titulaire_t *)entree->valeur)->pseudo);
+    pthread_mutex_unlock(&verrou_titulaires);
+    return entree != NULL;
+}
+
+/**
+ * Retient le rôle attribué dans un salon au titulaire d'un jeton, rendu à
+ * chacune de ses arrivées ; le rôle d'utilisateur efface le rôle retenu
+ * (verrou du salon tenu)
+ */
+static void noter_role(salon_t *salon, const char *jeton, const char *pseudo, int role) {
+    if (jeton[0] == '\0') return;
+    entree_index_t *entree = index_chercher(&salon->roles_retenus, jeton);
+    if (entree && role == ROLE_UTILISATEUR) {
+        const char *cle = entree->cle;
+        index_supprimer(&salon->roles_retenus, cle);
+        relacher_titulaire(cle);
+    } else if (entree) {
+        entree->valeur = (uintptr_t)role;
+    } else if (role != ROLE_UTILISATEUR) {
+        index_inserer(&salon->roles_retenus, prendre_titulaire(jeton, pseudo), (uintptr_t)role);
+    }
+    atomic_fetch_add_explicit(&version_persistante, 1, memory_order_relaxed);
+}
+
+/**
+ * Relève les salons du répertoire sous verrou_salons (section de lecture)
+ * @return tableau à libérer, valide jusqu'à la fin de la section
+ */
+static salon_t **relever_salons(size_t *nb_salons) {
+    verrouiller(&verrou_salons);
+    salon_t **salons = malloc((nb_salons_total ? nb_salons_total : 1) * sizeof(salon_t *));
+    if (!salons) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    *nb_salons = nb_salons_total;
+    memcpy(salons, liste_salons, nb_salons_total * sizeof(salon_t *));
+    pthread_mutex_unlock(&verrou_salons);
+    return salons;
+}
+
+/**
+ * Oublie les rôles retenus du titulaire d'un jeton dont le pseudo vient
+ * d'être libéré (aucun verrou tenu)
+ */
+static void oublier_roles(const char *jeton) {
+    char pseudo[MAX_PSEUDO];
+    if (jeton[0] == '\0' || !pseudo_du_titulaire(jeton, pseudo)) return;
+    rcu_lire_debut();
+    size_t nb_salons;
+    salon_t **salons = relever_salons(&nb_salons);
+    for (size_t i = 0; i < nb_salons; i++) {
+        verrouiller(&salons[i]->verrou);
+        if (index_chercher(&salons[i]->roles_retenus, jeton)) noter_role(salons[i], jeton, pseudo, ROLE_UTILISATEUR);
+        pthread_mutex_unlock(&salons[i]->verrou);
+    }
+    free(salons);
+    rcu_lire_fin();
+}
+
+/**
+ * Inscrit un client dans un salon et notifie les autres (verrou_salon du
+ * client tenu, section de lecture)
+ * @param role   rôle repris d'une session, ou -1 : rôle retenu pour son jeton,
+ *               administrateur s'il entre le premier dans un salon sans rôle
+ *               retenu (hors salon par défaut), utilisateur sinon
+ * @return 0, -1 si le salon vient d'être détruit, -2 si le client en est banni
+ */
+static int inscrire_dans_salon(salon_t *salon, client_t *client, int role) {
+    verrouiller(&salon->verrou);
+    if (salon->detruit) {
+        pthread_mutex_unlock(&salon->verrou);
+        return -1;
+    }
+    if (liste_bans_vise(&salon->bans, client->pseudo, client->adresse)) {
+        pthread_mutex_unlock(&salon->verrou);
+        return -2;
+    }
+    int retour = role >= 0;
+    if (!retour) {
+        entree_index_t *retenu = client->jeton[0] ? index_chercher(&salon->roles_retenus, client->jeton) : NULL;
+        role = retenu ? (int)retenu->valeur : ROLE_UTILISATEUR;
+        if (!retenu && salon != salon_par_defaut && salon->nb_membres == 0 && salon->roles_retenus.nb == 0) {
+            role = ROLE_ADMIN;
+            noter_role(salon, client->jeton, client->pseudo, role);
+        }
+    }
+    inserer_membre(partition_du_client(salon, client), client, role);
+    salon->nb_membres++;
+    client->role_courant = role;
+    client->salon_courant = salon;
+    pthread_mutex_unlock(&salon->verrou);
+
+    diffuser_avis(salon, client, retour ? "%s%s est de retour dans %s.\n" : "%s%s s'est connecté(e) dans %s.\n",
+                  obtenir_prefixe_selon_role(role), client->pseudo, salon->nom_salon);
+    return 0;
+}
+
+/**
+ * Ajoute un client à un salon, notifie les autres et lui rejoue l'historique
+ * (verrou_salon du client tenu, section de lecture)
+ * @return 0, -1 si le salon vient d'être détruit, -2 si le client en est banni
+ */
+int ajouter_client_au_salon(salon_t *salon, client_t *client) {
+    int resultat = inscrire_dans_salon(salon, client, -1);
+    if (resultat == 0) rejouer_historique(client, salon, capacite_historique);
+    return resultat;
+}
+
+/**
+ * Retire un client d'un salon et notifie les autres
+ * (verrou_salon du client tenu, section de lecture)
+ */
+void retirer_client_du_salon(client_t *client) {
+    salon_t *salon = client->salon_courant;
+    if (!salon) return;
+
+    // Supprime le client de la liste du salon : le dernier membre prend sa place
+    verrouiller(&salon->verrou);
+    salon->nb_membres -= supprimer_membre(partition_du_client(salon, client), client);
+    client->salon_courant = NULL;
+
+    // Si le salon (hors salon par défaut) est vide et qu'aucune session n'y
+    // reviendra, le libérer
+    int a_liberer = salon != salon_par_defaut && salon->nb_membres == 0 && salon->nb_sessions == 0;
+    if (a_liberer) salon->detruit = 1;
+    pthread_mutex_unlock(&salon->verrou);
+
+    diffuser_avis(salon, client, "%s s'est déconnecté(e) de %s.\n", client->pseudo, salon->nom_salon);
+
+    if (a_liberer) {
+        retirer_salon_du_repertoire(salon);
+        rcu_retirer(salon, salon_relacher);
+    }
+}
+
+/**
+ * Fait passer un client dans le salon demandé, créé au besoin (section de lecture)
+ * @return le salon rejoint, ou NULL s'il ne peut pas être créé ou si le client
+ *         en est banni (*banni vaut alors 1) ; le client est alors ramené dans
+ *         le salon par défaut
+ */
+salon_t *changer_de_salon(client_t *client, const char *nom_salon, int *banni) {
+    salon_t *salon_cible;
+    int resultat = 0;
+    verrouiller(&client->verrou_salon);
+    retirer_client_du_salon(client);
+    // Un salon trouvé peut être détruit avant qu'on y entre : on recommence
+    do {
+        salon_cible = obtenir_ou_creer_salon(nom_salon);
+    } while (salon_cible && (resultat = ajouter_client_au_salon(salon_cible, client)) == -1);
+    *banni = resultat == -2;
+    if (*banni) salon_cible = NULL;
+    if (!salon_cible) {
+        ajouter_client_au_salon(salon_par_defaut, client);
+    }
+    pthread_mutex_unlock(&client->verrou_salon);
+    return salon_cible;
+}
+
+/**
+ * Renvoie un membre dans le salon par défaut s'il est toujours dans le salon
+ * donné (expulsion, destruction) ; section de lecture
+ * @return 1 si le membre a été déplacé
+ */
+int renvoyer_dans_salon_par_defaut(client_t *cible, salon_t *depuis) {
+    int deplace = 0;
+    verrouiller(&cible->verrou_salon);
+    if (cible->salon_courant == depuis) {
+        retirer_client_du_salon(cible);
+        ajouter_client_au_salon(salon_par_defaut, cible);
+        deplace = 1;
+    }
+    pthread_mutex_unlock(&cible->verrou_salon);
+    return deplace;
+}
+
+/**
+ * Change le rôle d'un membre en publiant une nouvelle liste de membres
+ * @return 1 si le client était bien membre du salon
+ */
+int definir_role_dans_salon(salon_t *salon, client_t *membre, int role) {
+    verrouiller(&salon->verrou);
+    int membre_du_salon = modifier_role_membre(partition_du_client(salon, membre), membre, role);
+    if (membre_du_salon) {
+        membre->role_courant = role;
+        noter_role(salon, membre->jeton, membre->pseudo, role);
+    }
+    pthread_mutex_unlock(&salon->verrou);
+    return membre_du_salon;
+}
+
+/*
+ * Sessions. À l'inscription, chaque client reçoit un jeton de reprise. Si sa
+ * connexion tombe sans qu'il l'ait demandé, sa session (pseudo, salon, rôle et
+ * rang de la dernière ligne du salon qu'il a reçue) est gardée delai_session_s
+ * secondes : le pseudo reste réservé, ici comme sur les autres nœuds, et le
+ * salon n'est pas libéré. Une connexion qui envoie COMMANDE_REPRISE suivi du
+ * jeton au lieu d'un pseudo retrouve la session, puis reçoit en un seul envoi
+ * les lignes manquées que l'historique du salon garde encore. Le thread des
+ * sessions fait expirer celles qui ne sont pas reprises.
+ */
+
+// Session d'une connexion coupée, en attente de reprise (sous verrou_clients)
+typedef struct session {
+    struct session *precedente;     // liste par échéance croissante
+    struct session *suivante;
+    char jeton[2 * TAILLE_JETON + 1];
+    char pseudo[MAX_PSEUDO];
+    salon_t *salon;                 // gardé par salon->nb_sessions
+    int role;
+    uint64_t curseur;               // rang de la dernière ligne du salon reçue
+    uint64_t echeance_ns;
+} session_t;
+
+static unsigned int delai_session_s = DELAI_SESSION_DEFAUT;   // 0 : aucune reprise
+static index_t index_sessions;              // jeton -> session (sous verrou_clients)
+static index_t index_sessions_pseudos;      // pseudo -> session (sous verrou_clients)
+static session_t *premiere_session = NULL;  // la plus proche de son échéance
+static session_t *derniere_session = NULL;
+static pthread_cond_t condition_sessions;   // horloge monotone, voir demarrer_sessions()
+
+/**
+ * Tire le jeton de reprise d'un client avant son inscription : il ne change
+ * plus une fois le client visible des autres threads
+ */
+static void attribuer_jeton(client_t *client) {
+    unsigned char octets[TAILLE_JETON];
+    if (delai_session_s == 0 || getentropy(octets, sizeof(octets)) == -1) return;
+    for (int i = 0; i < TAILLE_JETON; i++) sprintf(client->jeton + 2 * i, "%02x", octets[i]);
+}
+
+/**
+ * Range une session par échéance et l'indexe (verrou_clients tenu) ; le
+ * délai étant le même pour toutes, elle va presque toujours en queue
+ */
+static void ranger_session(session_t *session) {
+    session_t *avant = derniere_session;
+    while (avant && avant->echeance_ns > session->echeance_ns) avant = avant->precedente;
+    session->precedente = avant;
+    session->suivante = avant ? avant->suivante : premiere_session;
+    if (session->suivante) session->suivante->precedente = session;
+    else derniere_session = session;
+    if (avant) avant->suivante = session;
+    else premiere_session = session;
+    index_inserer(&index_sessions, session->jeton, (uintptr_t)session);
+    index_inserer(&index_sessions_pseudos, session->pseudo, (uintptr_t)session);
+    if (premiere_session == session) pthread_cond_signal(&condition_sessions);
+}
+
+/**
+ * Retire une session de la liste et des index (verrou_clients tenu)
+ */
+static void detacher_session(session_t *session) {
+    if (session->precedente) session->precedente->suivante = session->suivante;
+    else premiere_session = session->suivante;
+    if (session->suivante) session->suivante->precedente = session->precedente;
+    else derniere_session = session->precedente;
+    index_supprimer(&index_sessions, session->jeton);
+    index_supprimer(&index_sessions_pseudos, session->pseudo);
+}
+
+/**
+ * Avance l'échéance d'une session à maintenant (verrou_clients tenu)
+ */
+static void expirer_session(session_t *session) {
+    detacher_session(session);
+    session->echeance_ns = 0;
+    ranger_session(session);
+}
+
+/**
+ * Prépare la session d'un client inscrit dont la connexion se ferme, avant
+ * qu'il quitte son salon : le salon ne sera pas libéré tant qu'elle dure
+ * (verrou_salon du client tenu, section de lecture)
+ * @return NULL si aucune session n'est gardée
+ */
+static session_t *preparer_session(client_t *client) {
+    verrouiller(&client->verrou_sortie);
+    int sans_reprise = client->sans_reprise;
+    pthread_mutex_unlock(&client->verrou_sortie);
+    if (sans_reprise || client->jeton[0] == '\0') return NULL;
+
+    session_t *session = malloc(sizeof(session_t));
+    if (!session) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    salon_t *salon = client->salon_courant;
+    session->role = salon ? client->role_courant : ROLE_UTILISATEUR;
+    if (!salon) salon = salon_par_defaut;     // déplacement en cours par un modérateur
+    verrouiller(&salon->verrou);
+    salon->nb_sessions++;
+    pthread_mutex_unlock(&salon->verrou);
+    session->salon = salon;
+    strcpy(session->jeton, client->jeton);
+    strcpy(session->pseudo, client->pseudo);
+    return session;
+}
+
+/**
+ * Garde jusqu'à son échéance la session d'un client qui a quitté son salon
+ * (verrou_clients tenu). Le curseur précède la première ligne de salon encore
+ * en file, ou à défaut suit la dernière diffusée.
+ */
+static void garder_session(session_t *session, client_t *client) {
+    session->curseur = atomic_load_explicit(&prochaine_sequence, memory_order_relaxed) - 1;
+    verrouiller(&client->verrou_sortie);
+    file_sortie_t *file = &client->sortie;
+    for (size_t i = 0; i < file->nb_segments; i++) {
+        message_t *message = file->segments[(file->tete + i) & (file->capacite - 1)].message;
+        if (message->sequence) {
+            session->curseur = message->sequence - 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client->verrou_sortie);
+    session->echeance_ns = horloge_ns() + delai_session_s * NS_PAR_S;
+    ranger_session(session);
+    compter(STAT_SESSIONS_GARDEES, 1);
+}
+
+/**
+ * Rend la place qu'une session tenait dans son salon ; le salon resté vide
+ * est libéré
+ */
+static void rendre_salon_de_session(salon_t *salon) {
+    verrouiller(&salon->verrou);
+    salon->nb_sessions--;
+    int a_liberer = salon != salon_par_defaut && salon->nb_membres == 0 && salon->nb_sessions == 0;
+    if (a_liberer) salon->detruit = 1;
+    pthread_mutex_unlock(&salon->verrou);
+    if (a_liberer) {
+        retirer_salon_du_repertoire(salon);
+        rcu_retirer(salon, salon_relacher);
+    }
+}
+
+/**
+ * Envoie d'un seul tenant à un client qui reprend sa session un en-tête puis
+ * les lignes du salon postérieures à son curseur que l'historique garde
+ * encore (section de lecture)
+ */
+static void rejouer_manques(client_t *client, salon_t *salon, uint64_t curseur) {
+    historique_t *historique = &salon->historique;
+    verrouiller(&historique->verrou);
+    message_t **lot = malloc((historique->nb + 1) * sizeof(message_t *));
+    if (!lot) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t nb = 0;
+    for (size_t i = 0; i < historique->nb; i++) {
+        message_t *message = historique->messages[(historique->debut + i) % capacite_historique];
+        if (message->sequence > curseur) lot[++nb] = message_prendre(message);
+    }
+    int lacune = historique->sequence_chassee > curseur;
+    pthread_mutex_unlock(&historique->verrou);
+
+    lot[0] = message_formater("Session reprise : %s dans %s, %zu message(s) manqué(s)%s.\n", client->pseudo,
+                              salon->nom_salon, nb, lacune ? ", les plus anciens ne sont plus disponibles" : "");
+    envoyer_messages(client, lot, nb + 1);
+    for (size_t i = 0; i <= nb; i++) {
+        message_relacher(lot[i]);
+    }
+    free(lot);
+}
+
+static void inscrire_client(client_t *client);
+int existe_deja_le_pseudo(const char *pseudo);
+
+/**
+ * Sans session à reprendre, rend au titulaire d'un jeton, après un
+ * redémarrage sur cliché, son pseudo s'il est libre ; ses rôles retenus lui
+ * seront rendus à l'entrée de ses salons (verrou_clients tenu, rendu en cas
+ * de succès)
+ * @return 1 si le client est inscrit, 0 sinon
+ */
+static int reprendre_titulaire(client_t *client, const char *jeton) {
+    char pseudo[MAX_PSEUDO];
+    if (!pseudo_du_titulaire(jeton, pseudo) || existe_deja_le_pseudo(pseudo) ||
+        banni_du_serveur(pseudo, client->adresse)) {
+        return 0;
+    }
+    strcpy(client->pseudo, pseudo);
+    snprintf(client->jeton, sizeof(client->jeton), "%s", jeton);
+    inscrire_client(client);
+    annoncer_pseudo(TRAME_PSEUDO_PRIS, client->pseudo);
+    pthread_mutex_unlock(&verrou_clients);
+    compter(STAT_SESSIONS_REPRISES, 1);
+
+    rcu_lire_debut();
+    verrouiller(&client->verrou_salon);
+    ajouter_client_au_salon(salon_par_defaut, client);
+    pthread_mutex_unlock(&client->verrou_salon);
+    char tampon[MAX_MESSAGE];
+    snprintf(tampon, sizeof(tampon), "Identité reprise : %s dans %s, vos rôles vous seront rendus dans vos salons.\n",
+             client->pseudo, salon_par_defaut->nom_salon);
+    rcu_lire_fin();
+    envoyer_texte(client, tampon);
+    return 1;
+}
+
+/**
+ * Reprend la session désignée par un jeton : le client retrouve son pseudo,
+ * son salon et son rôle, puis ce qu'il a manqué
+ * @return comme traiter_pseudo()
+ */
+static int reprendre_session(client_t *client, const char *jeton) {
+    verrouiller(&verrou_clients);
+    entree_index_t *entree = index_chercher(&index_sessions, jeton);
+    if (!entree) {
+        if (reprendre_titulaire(client, jeton)) return 1;
+        pthread_mutex_unlock(&verrou_clients);
+        envoyer_texte(client, "Jeton de reprise inconnu ou expiré.\n");
+        envoyer_texte(client, INVITE_PSEUDO);
+        return 0;
+    }
+    session_t *session = (session_t *)entree->valeur;
+    detacher_session(session);
+    int banni = banni_du_serveur(session->pseudo, client->adresse);
+    if (banni) {
+        annoncer_pseudo(TRAME_PSEUDO_LIBRE, session->pseudo);
+    } else {
+        strcpy(client->pseudo, session->pseudo);
+        strcpy(client->jeton, session->jeton);
+        inscrire_client(client);
+    }
+    pthread_mutex_unlock(&verrou_clients);
+
+    rcu_lire_debut();
+    salon_t *salon = NULL;
+    if (!banni) {
+        compter(STAT_SESSIONS_REPRISES, 1);
+        verrouiller(&client->verrou_salon);
+        salon = session->salon;
+        if (inscrire_dans_salon(salon, client, session->role) < 0) {
+            // Salon détruit ou client banni du salon entre-temps
+            salon = salon_par_defaut;
+            ajouter_client_au_salon(salon, client);
+        }
+        pthread_mutex_unlock(&client->verrou_salon);
+    }
+    rendre_salon_de_session(session->salon);
+    if (banni) {
+        envoyer_texte(client, "Vous êtes banni du serveur.\n");
+    } else if (salon == session->salon) {
+        rejouer_manques(client, salon, session->curseur);
+    } else {
+        char tampon[MAX_MESSAGE];
+        snprintf(tampon, sizeof(tampon), "Session reprise : %s, votre salon n'est plus accessible, vous êtes dans %s.\n",
+                 client->pseudo, salon->nom_salon);
+        envoyer_texte(client, tampon);
+    }
+    rcu_lire_fin();
+    if (banni) oublier_roles(session->jeton);
+    free(session);
+    return banni ? -1 : 1;
+}
+
+/**
+ * Thread des sessions : libère, à leur échéance, les sessions qui n'ont pas
+ * été reprises
+ */
+static void *boucle_sessions(void *arg) {
+    (void)arg;
+    verrouiller(&verrou_clients);
+    for (;;) {
+        session_t *session = premiere_session;
+        if (!session) {
+            pthread_cond_wait(&condition_sessions, &verrou_clients);
+            continue;
+        }
+        if (session->echeance_ns > horloge_ns()) {
+            struct timespec echeance = { (time_t)(session->echeance_ns / NS_PAR_S), (long)(session->echeance_ns % NS_PAR_S) };
+            pthread_cond_timedwait(&condition_sessions, &verrou_clients, &echeance);
+            continue;
+        }
+        detacher_session(session);
+        annoncer_pseudo(TRAME_PSEUDO_LIBRE, session->pseudo);
+        pthread_mutex_unlock(&verrou_clients);
+        rendre_salon_de_session(session->salon);
+        oublier_roles(session->jeton);
+        free(session);
+        verrouiller(&verrou_clients);
+    }
+    return NULL;
+}
+
+/**
+ * Lance le thread des sessions (avant toute connexion, et avant la reprise
+ * d'un état qui en contient)
+ */
+void demarrer_sessions(void) {
+    pthread_condattr_t attributs;
+    pthread_condattr_init(&attributs);
+    pthread_condattr_setclock(&attributs, CLOCK_MONOTONIC);
+    pthread_cond_init(&condition_sessions, &attributs);
+    pthread_condattr_destroy(&attributs);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, boucle_sessions, NULL) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(thread);
+}
+
+/**
+ * Vérifie si un pseudo est déjà utilisé, ici, par une session en attente de
+ * reprise ou sur un autre nœud (verrou_clients tenu)
+ */
+int existe_deja_le_pseudo(const char *pseudo) {
+    return index_chercher(&index_pseudos, pseudo) != NULL || index_chercher(&index_sessions_pseudos, pseudo) != NULL ||
+           index_chercher(&index_pseudos_distants, pseudo) != NULL;
+}
+
+/**
+ * Lit un numéro de page facultatif (1 par défaut) en tête des arguments
+ * @return la suite des arguments, sans espaces initiaux
+ */
+static const char *lire_page(const char *arguments, size_t *page) {
+    while (*arguments == ' ') arguments++;
+    *page = 1;
+    if (*arguments >= '0' && *arguments <= '9') {
+        char *fin;
+        unsigned long n = strtoul(arguments, &fin, 10);
+        if (*fin == ' ' || *fin == '\0') {
+            if (n > 0 && n <= MAX_PAGE_LISTE) *page = n;
+            arguments = fin;
+            while (*arguments == ' ') arguments++;
+        }
+    }
+    return arguments;
+}
+
+static int comparer_noms(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+/**
+ * Retourne l'annuaire des salons à jour (section de lecture). Il n'est
+ * reconstruit que si un salon a été créé ou supprimé depuis la dernière
+ * construction, par un seul thread à la fois ; les lecteurs ne prennent
+ * aucun verrou.
+ */
+static annuaire_salons_t *obtenir_annuaire(void) {
+    annuaire_salons_t *annuaire = atomic_load_explicit(&annuaire_salons, memory_order_acquire);
+    if (annuaire && annuaire->version == atomic_load_explicit(&version_salons, memory_order_acquire)) return annuaire;
+
+    verrouiller(&verrou_annuaire);
+    annuaire = atomic_load_explicit(&annuaire_salons, memory_order_acquire);
+    if (!annuaire || annuaire->version != atomic_load_explicit(&version_salons, memory_order_acquire)) {
+        annuaire_salons_t *ancien = annuaire;
+        verrouiller(&verrou_salons);
+        annuaire = malloc(sizeof(annuaire_salons_t) + nb_salons_total * MAX_NOM_SALON);
+        if (!annuaire) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        annuaire->version = atomic_load_explicit(&version_salons, memory_order_relaxed);
+        annuaire->nb = nb_salons_total;
+        for (size_t i = 0; i < nb_salons_total; i++) {
+            memcpy(annuaire->noms[i], liste_salons[i]->nom_salon, MAX_NOM_SALON);
+        }
+        pthread_mutex_unlock(&verrou_salons);
+        qsort(annuaire->noms, annuaire->nb, MAX_NOM_SALON, comparer_noms);
+        atomic_store_explicit(&annuaire_salons, annuaire, memory_order_release);
+        if (ancien) rcu_retirer(ancien, free);
+    }
+    pthread_mutex_unlock(&verrou_annuaire);
+    return annuaire;
+}
+
+/**
+ * Envoie une page de la liste des salons, éventuellement restreinte à ceux
+ * dont le nom commence par un préfixe (section de lecture). La liste triée
+ * est parcourue à partir d'une recherche dichotomique : coût en O(page).
+ */
+void envoyer_liste_des_salons(client_t *client, const char *arguments) {
+    size_t page;
+    const char *prefixe = lire_page(arguments, &page);
+    size_t longueur_prefixe = strlen(prefixe);
+    annuaire_salons_t *annuaire = obtenir_annuaire();
+
+    // Premier nom >= préfixe, puis fin de la plage des noms qui le portent
+    size_t debut = 0, fin = annuaire->nb;
+    while (debut < fin) {
+        size_t milieu = debut + (fin - debut) / 2;
+        if (strncmp(annuaire->noms[milieu], prefixe, MAX_NOM_SALON) < 0) debut = milieu + 1;
+        else fin = milieu;
+    }
+    fin = annuaire->nb;
+    size_t borne = debut;
+    while (borne < fin) {
+        size_t milieu = borne + (fin - borne) / 2;
+        if (strncmp(annuaire->noms[milieu], prefixe, longueur_prefixe) == 0) borne = milieu + 1;
+        else fin = milieu;
+    }
+    size_t nb = borne - debut;
+
+    texte_t texte = { NULL, 0, 0 };
+    texte_ajouter(&texte, "Salons disponibles:\n");
+    size_t premier = (page - 1) * TAILLE_PAGE_LISTE;
+    for (size_t i = premier; i < nb && i < premier + TAILLE_PAGE_LISTE; i++) {
+        texte_ajouter(&texte, "- %s\n", annuaire->noms[debut + i]);
+    }
+    if (nb > TAILLE_PAGE_LISTE) {
+        texte_ajouter(&texte, "Page %zu/%zu (%zu salons) : /channels <page> [préfixe]\n",
+                      page, (nb + TAILLE_PAGE_LISTE - 1) / TAILLE_PAGE_LISTE, nb);
+    }
+    envoyer_au_client(client, texte.octets, texte.longueur);
+    free(texte.octets);
+}
+
+/**
+ * Envoie une page des membres d'un salon (section de lecture). Les listes
+ * publiées par partition sont lues sans verrou ; la page est atteinte en
+ * sautant des blocs entiers.
+ */
+void envoyer_liste_des_membres(client_t *client, salon_t *salon, const char *arguments) {
+    size_t page;
+    lire_page(arguments, &page);
+
+    size_t nb = 0;
+    for (int p = 0; p < nb_partitions; p++) {
+        nb += (size_t)atomic_load_explicit(&salon->partitions[p].membres, memory_order_acquire)->nb_clients;
+    }
+
+    texte_t texte = { NULL, 0, 0 };
+    texte_ajouter(&texte, "Membres de %s:\n", salon->nom_salon);
+    size_t a_sauter = (page - 1) * TAILLE_PAGE_LISTE, restants = TAILLE_PAGE_LISTE;
+    for (int p = 0; p < nb_partitions && restants > 0; p++) {
+        instantane_salon_t *membres = atomic_load_explicit(&salon->partitions[p].membres, memory_order_acquire);
+        for (int b = 0; b < membres->nb_blocs && restants > 0; b++) {
+            bloc_membres_t *bloc = membres->blocs[b];
+            if (a_sauter >= (size_t)bloc->nb) {
+                a_sauter -= (size_t)bloc->nb;
+                continue;
+            }
+            for (int i = (int)a_sauter; i < bloc->nb && restants > 0; i++, restants--) {
+                texte_ajouter(&texte, "- %s%s\n", obtenir_prefixe_selon_role(roles_du_bloc(bloc)[i]), bloc->clients[i]->pseudo);
+            }
+            a_sauter = 0;
+        }
+    }
+    if (nb > TAILLE_PAGE_LISTE) {
+        texte_ajouter(&texte, "Page %zu/%zu (%zu membres) : /who <page>\n",
+                      page, (nb + TAILLE_PAGE_LISTE - 1) / TAILLE_PAGE_LISTE, nb);
+    }
+    envoyer_au_client(client, texte.octets, texte.longueur);
+    free(texte.octets);
+}
+
+/*
+ * Trace des entrées (-e). Chaque événement d'une connexion (arrivée, octets
+ * reçus, départ) est ajouté au tampon du thread qui la sert ; un réacteur
+ * l'écrit à la fin de chaque tour de boucle, un thread par connexion tout de
+ * suite. Chaque écriture est un seul write() en O_APPEND : les événements
+ * d'une connexion restent dans l'ordre, ceux de connexions servies par des
+ * threads différents peuvent se croiser (le rejeu les trie par date).
+ *
+ * Format, entiers dans l'ordre de l'hôte : en-tête { MAGIQUE_TRACE,
+ * VERSION_TRACE } sur 32 bits chacun, puis des enregistrements { type 8 bits,
+ * connexion 32 bits, date CLOCK_REALTIME en ns 64 bits, longueur 32 bits,
+ * octets }. Une arrivée porte l'adresse IPv4 du pair (4 octets).
+ */
+
+enum { TRACE_ARRIVEE, TRACE_OCTETS, TRACE_DEPART };
+
+static int descripteur_trace = -1;
+static __thread texte_t tampon_trace = { NULL, 0, 0 };
+static _Atomic uint32_t prochain_numero = 1;
+
+/**
+ * Écrit le tampon de trace du thread courant
+ */
+static void vider_trace(void) {
+    if (tampon_trace.longueur == 0) return;
+    size_t ecrit = 0;
+    while (ecrit < tampon_trace.longueur) {
+        ssize_t n = write(descripteur_trace, tampon_trace.octets + ecrit, tampon_trace.longueur - ecrit);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("write trace");
+            break;
+        }
+        ecrit += (size_t)n;
+    }
+    tampon_trace.longueur = 0;
+}
+
+/**
+ * Ajoute un événement à la trace (octets répartis sur nb_morceaux)
+ */
+static void tracer(client_t *client, int type, const struct iovec *morceaux, int nb_morceaux, size_t longueur) {
+    if (descripteur_trace < 0) return;
+    struct timespec maintenant;
+    clock_gettime(CLOCK_REALTIME, &maintenant);
+    uint8_t code = (uint8_t)type;
+    uint64_t date = (uint64_t)maintenant.tv_sec * NS_PAR_S + (uint64_t)maintenant.tv_nsec;
+    uint32_t longueur_trace = (uint32_t)longueur;
+    texte_copier(&tampon_trace, &code, sizeof(code));
+    texte_copier(&tampon_trace, &client->numero, sizeof(client->numero));
+    texte_copier(&tampon_trace, &date, sizeof(date));
+    texte_copier(&tampon_trace, &longueur_trace, sizeof(longueur_trace));
+    for (int i = 0; i < nb_morceaux && longueur > 0; i++) {
+        size_t n = morceaux[i].iov_len < longueur ? morceaux[i].iov_len : longueur;
+        texte_copier(&tampon_trace, morceaux[i].iov_base, n);
+        longueur -= n;
+    }
+    if (!client->reacteur || tampon_trace.longueur >= SEUIL_TAMPON_TRACE) vider_trace();
+}
+
+/**
+ * Trace l'arrivée d'une connexion, avec l'adresse de son pair
+ */
+static void tracer_arrivee(client_t *client) {
+    struct iovec adresse = { &client->adresse, sizeof(client->adresse) };
+    tracer(client, TRACE_ARRIVEE, &adresse, 1, sizeof(client->adresse));
+}
+
+/**
+ * Ouvre le fichier de trace en ajout ; l'en-tête n'est écrit que dans un
+ * fichier vide (un remplaçant continue la trace de son prédécesseur)
+ */
+void ouvrir_trace(const char *chemin) {
+    descripteur_trace = open(chemin, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    struct stat etat;
+    if (descripteur_trace == -1 || fstat(descripteur_trace, &etat) == -1) {
+        perror(chemin);
+        exit(EXIT_FAILURE);
+    }
+    if (etat.st_size == 0) {
+        uint32_t entete[2] = { MAGIQUE_TRACE, VERSION_TRACE };
+        if (write(descripteur_trace, entete, sizeof(entete)) != (ssize_t)sizeof(entete)) {
+            perror(chemin);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * Alloue un client pour une connexion acceptée, encore sans pseudo
+ */
+client_t *creer_client(int descripteur, uint32_t adresse, reacteur_t *reacteur) {
+    client_t *client = pool_allouer(&pool_clients);
+    memset(client, 0, sizeof(client_t));
+    client->descripteur = descripteur;
+    client->adresse = adresse;
+    client->numero = atomic_fetch_add_explicit(&prochain_numero, 1, memory_order_relaxed);
+    client->etat = ETAT_PSEUDO;
+    client->reacteur = reacteur;
+    atomic_init(&client->salon_courant, NULL);
+    pthread_mutex_init(&client->verrou_salon, NULL);
+    pthread_mutex_init(&client->verrou_sortie, NULL);
+    return client;
+}
+
+/**
+ * Libère un client ; différé tant qu'une diffusion peut encore le voir
+ */
+static void liberer_client(void *objet) {
+    client_t *client = objet;
+    pthread_mutex_destroy(&client->verrou_salon);
+    pthread_mutex_destroy(&client->verrou_sortie);
+    file_vider(&client->sortie);
+    if (client->entree.octets) pool_rendre(&pool_entrees, client->entree.octets);
+    pool_rendre(&pool_clients, client);
+}
+
+/**
+ * Mémoire occupée en moyenne par une connexion, hors tampons du noyau,
+ * files de sortie et tampons d'entrée (rendus dès qu'aucune ligne n'est en
+ * cours de réception) : objet client, places dans le répertoire et l'index des
+ * pseudos, place dans la liste et l'index des membres de son salon. Sans
+ * client inscrit, donne le coût minimal d'une connexion.
+ */
+size_t octets_par_connexion(void) {
+    // Chaque client est dans exactement un index de membres, qui grandit
+    // comme l'index des pseudos : on compte le même remplissage pour les deux
+    verrouiller(&verrou_clients);
+    size_t nb = nb_clients_total;
+    size_t octets = capacite_clients * sizeof(client_t *) + 2 * index_pseudos.capacite * sizeof(entree_index_t);
+    pthread_mutex_unlock(&verrou_clients);
+    if (nb == 0) {
+        return pool_clients.taille_objet + sizeof(client_t *) + 2 * sizeof(entree_index_t) * 10 / 7
+               + sizeof(client_t *) + 1;
+    }
+    octets += pool_octets(&pool_clients) + atomic_load_explicit(&octets_membres, memory_order_relaxed);
+    return octets / nb;
+}
+
+/**
+ * Ajoute le résumé d'un histogramme, sommé sur tous les threads : nombre de
+ * mesures puis quantiles et maximum en µs (borne haute de leur tranche)
+ */
+static void rediger_histogramme(texte_t *texte, const char *nom, size_t champ) {
+    uint64_t somme[NB_TRANCHES_HISTOGRAMME] = { 0 };
+    uint64_t total = 0;
+    for (statistiques_t *s = atomic_load(&liste_statistiques); s; s = s->suivant) {
+        const histogramme_t *histogramme = (const histogramme_t *)((const char *)s + champ);
+        for (int i = 0; i < NB_TRANCHES_HISTOGRAMME; i++) {
+            uint64_t n = atomic_load_explicit(&histogramme->tranches[i], memory_order_relaxed);
+            somme[i] += n;
+            total += n;
+        }
+    }
+
+    static const double quantiles[] = { 0.5, 0.99, 0.999, 1.0 };
+    static const char *const noms_quantiles[] = { "p50", "p99", "p999", "max" };
+    texte_ajouter(texte, "%s nombre=%llu", nom, (unsigned long long)total);
+    uint64_t cumul = 0;
+    int tranche = 0;
+    for (int q = 0; q < 4; q++) {
+        uint64_t rang = total ? (uint64_t)(quantiles[q] * (double)(total - 1)) + 1 : 0;
+        while (total && tranche < NB_TRANCHES_HISTOGRAMME - 1 && cumul + somme[tranche] < rang) {
+            cumul += somme[tranche++];
+        }
+        texte_ajouter(texte, " %s=%.1f", noms_quantiles[q], total ? (double)borne_tranche(tranche) / 1000.0 : 0.0);
+    }
+    texte_ajouter(texte, "\n");
+}
+
+typedef struct occupation_salon {
+    salon_t *salon;
+    int nb_membres;
+} occupation_salon_t;
+
+static int comparer_occupations(const void *a, const void *b) {
+    const occupation_salon_t *x = a, *y = b;
+    return (y->nb_membres > x->nb_membres) - (y->nb_membres < x->nb_membres);
+}
+
+/**
+ * Rédige l'état du serveur, une mesure par ligne ("nom valeur") : compteurs,
+ * histogrammes, files de sortie, mémoire, journal, puis les max_salons salons
+ * les plus peuplés. Aucun verrou du chemin des messages n'est tenu longtemps :
+ * les membres sont comptés sur les listes publiées, sans le verrou des salons.
+ */
+void rediger_statistiques(texte_t *texte, size_t max_salons) {
+    uint64_t totaux[NB_STATS] = { 0 };
+    for (statistiques_t *s = atomic_load(&liste_statistiques); s; s = s->suivant) {
+        for (int i = 0; i < NB_STATS; i++) {
+            totaux[i] += atomic_load_explicit(&s->compteurs[i], memory_order_relaxed);
+        }
+    }
+    for (int i = 0; i < NB_STATS; i++) {
+        texte_ajouter(texte, "%s %llu\n", noms_stats[i], (unsigned long long)totaux[i]);
+    }
+    rediger_histogramme(texte, "latence_diffusion_us", offsetof(statistiques_t, latence_diffusion));
+    rediger_histogramme(texte, "attente_verrou_us", offsetof(statistiques_t, attente_verrou));
+
+    // Profondeur des files de sortie des clients inscrits
+    size_t nb_clients = 0, en_file = 0, en_file_max = 0, nb_en_retard = 0;
+    verrouiller(&verrou_clients);
+    for (size_t i = 0; i < nb_clients_total; i++) {
+        client_t *client = liste_clients[i];
+        verrouiller(&client->verrou_sortie);
+        en_file += client->sortie.octets;
+        if (client->sortie.octets > en_file_max) en_file_max = client->sortie.octets;
+        nb_en_retard += (size_t)client->en_retard;
+        pthread_mutex_unlock(&client->verrou_sortie);
+    }
+    nb_clients = nb_clients_total;
+    size_t nb_sessions = index_sessions.nb;
+    pthread_mutex_unlock(&verrou_clients);
+    texte_ajouter(texte, "clients_inscrits %zu\n", nb_clients);
+    texte_ajouter(texte, "sessions_en_attente %zu\n", nb_sessions);
+    texte_ajouter(texte, "file_sortie_octets %zu\n", en_file);
+    texte_ajouter(texte, "file_sortie_octets_max %zu\n", en_file_max);
+    texte_ajouter(texte, "clients_en_retard %zu\n", nb_en_retard);
+    texte_ajouter(texte, "octets_perdus %lu\n", (unsigned long)atomic_load(&octets_perdus_total));
+    texte_ajouter(texte, "deconnexions_lenteur %lu\n", (unsigned long)atomic_load(&deconnexions_lenteur));
+    if (reveil_federation >= 0) {
+        rcu_lire_debut();
+        texte_ajouter(texte, "liens_federation %zu\n", atomic_load_explicit(&liens_etablis, memory_order_acquire)->nb);
+        rcu_lire_fin();
+        verrouiller(&verrou_clients);
+        texte_ajouter(texte, "pseudos_distants %zu\n", index_pseudos_distants.nb);
+        pthread_mutex_unlock(&verrou_clients);
+    }
+
+    texte_ajouter(texte, "memoire_par_connexion %zu\n", octets_par_connexion());
+    texte_ajouter(texte, "memoire_membres %zu\n", atomic_load(&octets_membres));
+    texte_ajouter(texte, "memoire_historiques %zu\n", atomic_load(&octets_historiques));
+    texte_ajouter(texte, "memoire_tampons_entree %zu\n", pool_octets(&pool_entrees));
+
+    if (journal.descripteur >= 0) {
+        texte_ajouter(texte, "journal_ecrits %lu\n", (unsigned long)journal.nb_ecrits);
+        texte_ajouter(texte, "journal_lots %lu\n", (unsigned long)journal.nb_lots);
+        texte_ajouter(texte, "journal_fdatasync %lu\n", (unsigned long)journal.nb_fdatasync);
+        texte_ajouter(texte, "journal_en_attente %lu\n", (unsigned long)journal.en_attente);
+        texte_ajouter(texte, "journal_perdus %lu\n", (unsigned long)journal.perdus);
+        texte_ajouter(texte, "journal_attente_max_us %lu\n", (unsigned long)journal.attente_max_us);
+    }
+
+    // Salons, du plus peuplé au moins peuplé
+    rcu_lire_debut();
+    verrouiller(&verrou_salons);
+    size_t nb_salons = nb_salons_total;
+    occupation_salon_t *occupations = malloc((nb_salons + 1) * sizeof(occupation_salon_t));
+    if (!occupations) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < nb_salons; i++) {
+        occupations[i].salon = liste_salons[i];
+    }
+    pthread_mutex_unlock(&verrou_salons);
+    for (size_t i = 0; i < nb_salons; i++) {
+        occupations[i].nb_membres = 0;
+        for (int p = 0; p < nb_partitions; p++) {
+            partition_salon_t *partition = &occupations[i].salon->partitions[p];
+            occupations[i].nb_membres += atomic_load_explicit(&partition->membres, memory_order_acquire)->nb_clients;
+        }
+    }
+    qsort(occupations, nb_salons, sizeof(occupation_salon_t), comparer_occupations);
+    texte_ajouter(texte, "salons %zu\n", nb_salons);
+    for (size_t i = 0; i < nb_salons && i < max_salons; i++) {
+        historique_t *historique = &occupations[i].salon->historique;
+        verrouiller(&historique->verrou);
+        size_t nb_historique = historique->nb;
+        pthread_mutex_unlock(&historique->verrou);
+        texte_ajouter(texte, "salon %s membres=%d historique=%zu\n",
+                      occupations[i].salon->nom_salon, occupations[i].nb_membres, nb_historique);
+    }
+    rcu_lire_fin();
+    free(occupations);
+}
+
+/**
+ * Inscrit un client qui a obtenu son pseudo dans le répertoire des clients
+ * (verrou_clients tenu)
+ */
+static void inscrire_client(client_t *client) {
+    liste_clients = reserver_place(liste_clients, nb_clients_total, &capacite_clients, sizeof(client_t *));
+    client->indice_liste = nb_clients_total;
+    liste_clients[nb_clients_total++] = client;
+    index_inserer(&index_pseudos, client->pseudo, (uintptr_t)client);
+    client->etat = ETAT_CONNECTE;
+}
+
+/**
+ * Traite un pseudo proposé pendant la poignée de main (ligne sans fin de
+ * ligne), ou une demande de reprise de session
+ * @return 1 si le client a rejoint le salon par défaut (ou celui de sa
+ *         session), 0 s'il doit proposer un autre pseudo, -1 si la connexion
+ *         doit être fermée
+ */
+int traiter_pseudo(client_t *client, char *pseudo) {
+    char tampon[MAX_MESSAGE];
+
+    if (strncmp(pseudo, COMMANDE_REPRISE, strlen(COMMANDE_REPRISE)) == 0) {
+        return reprendre_session(client, pseudo + strlen(COMMANDE_REPRISE));
+    }
+    if (strlen(pseudo) >= MAX_PSEUDO) pseudo[MAX_PSEUDO - 1] = '\0';
+    if (pseudo[0] == '\0') {
+        envoyer_texte(client, INVITE_PSEUDO);
+        return 0;
+    }
+
+    if (banni_du_serveur(pseudo, client->adresse)) {
+        envoyer_texte(client, "Vous êtes banni du serveur.\n");
+        return -1;
+    }
+
+    // Vérification et inscription sous le même verrou : deux clients ne
+    // peuvent pas obtenir le même pseudo
+    attribuer_jeton(client);
+    verrouiller(&verrou_clients);
+    if (existe_deja_le_pseudo(pseudo)) {
+        pthread_mutex_unlock(&verrou_clients);
+        envoyer_texte(client, "Pseudo déjà pris.\n");
+        envoyer_texte(client, INVITE_PSEUDO);
+        return 0;
+    }
+    strncpy(client->pseudo, pseudo, MAX_PSEUDO);
+    inscrire_client(client);
+    annoncer_pseudo(TRAME_PSEUDO_PRIS, client->pseudo);
+    pthread_mutex_unlock(&verrou_clients);
+    compter(STAT_INSCRIPTIONS, 1);
+
+    rcu_lire_debut();
+    verrouiller(&client->verrou_salon);
+    ajouter_client_au_salon(salon_par_defaut, client);
+    pthread_mutex_unlock(&client->verrou_salon);
+    rcu_lire_fin();
+
+    // Envoi du message de bienvenue
+    snprintf(tampon, sizeof(tampon), "Bienvenue %s dans %s !\n", client->pseudo, salon_par_defaut->nom_salon);
+    envoyer_texte(client, tampon);
+    if (client->jeton[0] != '\0') {
+        snprintf(tampon, sizeof(tampon), "Jeton de reprise : %s\n", client->jeton);
+        envoyer_texte(client, tampon);
+    }
+    return 1;
+}
+
+// Lignes que traiter_commande() reconnaît comme commandes, à tenir en accord
+// avec ses branches : exactes, ou préfixes suivis d'arguments. Toute autre
+// ligne, même commençant par '/', est diffusée au salon.
+static const struct {
+    const char *texte;
+    int exacte;
+} commandes[] = {
+    { "/exit", 1 },     { "/channels", 1 }, { "/channels ", 0 }, { "/who", 1 },
+    { "/who ", 0 },     { "/join ", 0 },    { "/history", 1 },    { "/history ", 0 },
+    { "/stats", 1 },    { "/date", 1 },     { "/msg ", 0 },       { "/kick ", 0 },
+    { "/ban ", 0 },     { "/unban ", 0 },   { "/bans", 1 },       { "/promote ", 0 },
+    { "/destroy", 1 },
+};
+
+/**
+ * Indique si une ligne (sans fin de ligne) est une commande plutôt qu'un
+ * message diffusé
+ */
+static int est_commande(const char *ligne) {
+    if (ligne[0] != '/') return 0;
+    for (size_t i = 0; i < sizeof(commandes) / sizeof(commandes[0]); i++) {
+        if (commandes[i].exacte ? strcmp(ligne, commandes[i].texte) == 0
+                                : strncmp(ligne, commandes[i].texte, strlen(commandes[i].texte)) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Exécute une commande ou diffuse un message reçu d'un client inscrit (ligne
+ * sans fin de ligne).
+ * Aucune commande ne prend de verrou global : seuls le salon concerné et,
+ * brièvement, les répertoires de clients et de salons sont verrouillés.
+ * @return -1 si le client demande à quitter, 0 sinon
+ */
+int traiter_commande(client_t *client, char *tampon) {
+    // Gestion des différentes commandes
+    if (strcmp(tampon, "/exit") == 0) {
+        // /exit : déconnexion propre, sans session à reprendre
+        verrouiller(&client->verrou_sortie);
+        client->sans_reprise = 1;
+        pthread_mutex_unlock(&client->verrou_sortie);
+        return -1;
+    }
+
+    // Les salons et clients lus ici restent valides jusqu'à rcu_lire_fin()
+    rcu_lire_debut();
+    salon_t *salon_actuel = client->salon_courant;
+
+    if (salon_actuel == NULL) {
+        // Déplacement en cours par un modérateur : rien à faire
+    } else if (strcmp(tampon, "/channels") == 0 || strncmp(tampon, "/channels ", 10) == 0) {
+        // /channels [page] [préfixe] : lister les salons, par pages
+        envoyer_liste_des_salons(client, tampon + 9);
+
+    } else if (strcmp(tampon, "/who") == 0 || strncmp(tampon, "/who ", 5) == 0) {
+        // /who [page] : lister les membres du salon courant, par pages
+        envoyer_liste_des_membres(client, salon_actuel, tampon + 4);
+
+    } else if (strncmp(tampon, "/join channel", 6) == 0) {
+        // /join <salon> : quitter l'ancien salon et rejoindre (ou créer) le nouveau
+        char *nom_salon = tampon + 6;
+        int banni;
+        salon_t *salon_cible = changer_de_salon(client, nom_salon, &banni);
+        if (banni) {
+            envoyer_texte(client, "Vous êtes banni de ce salon.\n");
+        } else if (salon_cible == NULL) {
+            envoyer_texte(client, "Impossible de créer ou rejoindre le salon.\n");
+        } else {
+            char msg_confirm[MAX_MESSAGE];
+            snprintf(msg_confirm, sizeof(msg_confirm), "Vous avez rejoint %s.\n", salon_cible->nom_salon);
+            envoyer_texte(client, msg_confirm);
+        }
+
+    } else if (strcmp(tampon, "/history") == 0 || strncmp(tampon, "/history ", 9) == 0) {
+        // /history [N] : renvoyer les N derniers messages du salon (tous par défaut)
+        long nb_demandes = tampon[8] ? atol(tampon + 9) : (long)capacite_historique;
+        if (nb_demandes <= 0) {
+            envoyer_texte(client, "Usage : /history [N]\n");
+        } else if (rejouer_historique(client, salon_actuel, (size_t)nb_demandes) == 0) {
+            envoyer_texte(client, "Aucun message récent dans ce salon.\n");
+        }
+
+    } else if (strcmp(tampon, "/stats") == 0) {
+        // /stats : compteurs et latences du serveur (administrateurs)
+        if (obtenir_role_dans_salon(salon_actuel, client) < ROLE_ADMIN) {
+            envoyer_texte(client, "Permission refusée.\n");
+        } else {
+            texte_t texte = { NULL, 0, 0 };
+            rediger_statistiques(&texte, MAX_SALONS_STATS);
+            envoyer_au_client(client, texte.octets, texte.longueur);
+            free(texte.octets);
+        }
+
+    }  else if (strcmp(tampon, "/date") == 0) {
+        // /date : envoyer la date et l'heure du serveur
+        time_t maintenant = time(NULL);
+        struct tm tm_local;
+        char msg_date[MAX_MESSAGE];
+        strftime(msg_date, sizeof(msg_date), "Date serveur : %d/%m/%Y %H:%M:%S\n", localtime_r(&maintenant, &tm_local));
+        envoyer_texte(client, msg_date);
+
+    } else if (strncmp(tampon, "/msg ", 5) == 0) {
+        // /msg <pseudo> <message> : message privé, routé par l'index des
+        // pseudos directement vers la connexion cible, quel que soit son salon
+        char *pseudo_cible = tampon + 5;
+        char *texte = strchr(pseudo_cible, ' ');
+        if (!texte || texte == pseudo_cible || texte[1] == '\0') {
+            envoyer_texte(client, "Usage : /msg <pseudo> <message>\n");
+        } else {
+            *texte++ = '\0';
+            client_t *cible = trouver_client_par_pseudo(pseudo_cible);
+            if (!cible) {
+                envoyer_texte(client, "Utilisateur introuvable.\n");
+            } else {
+                message_t *message = message_formater("[MP de %s] %s\n", client->pseudo, texte);
+                envoyer_message(cible, message);
+                message_relacher(message);
+                message = message_formater("[MP à %s] %s\n", cible->pseudo, texte);
+                envoyer_message(client, message);
+                message_relacher(message);
+            }
+        }
+
+    } else if (strncmp(tampon, "/kick ", 6) == 0) {
+        // /kick <pseudo> : expulser un utilisateur du salon courant
+        if (salon_actuel == salon_par_defaut) {
+            envoyer_texte(client, "Commande indisponible dans le salon par défaut.\n");
+        } else if (obtenir_role_dans_salon(salon_actuel, client) < ROLE_MODERATEUR) {
+            envoyer_texte(client, "Permission refusée.\n");
+        } else {
+            char *pseudo_cible = tampon + 6;
+            client_t *cible = trouver_membre_par_pseudo(salon_actuel, pseudo_cible, NULL);
+            if (cible && renvoyer_dans_salon_par_defaut(cible, salon_actuel)) {
+                envoyer_texte(cible, "Vous avez été expulsé du salon.\n");
+                diffuser_dans_salon(salon_actuel, NULL, "%s a été expulsé du salon.\n", pseudo_cible);
+            }
+        }
+
+    } else if (strncmp(tampon, "/ban ", 5) == 0 || strncmp(tampon, "/unban ", 7) == 0 || strcmp(tampon, "/bans") == 0) {
+        // /ban <pseudo|adresse[/longueur]> [minutes] : bannir du salon courant
+        // (définitivement sans durée) ; /unban <cible> : lever ; /bans : lister
+        if (salon_actuel == salon_par_defaut) {
+            envoyer_texte(client, "Commande indisponible dans le salon par défaut.\n");
+        } else if (obtenir_role_dans_salon(salon_actuel, client) < ROLE_MODERATEUR) {
+            envoyer_texte(client, "Permission refusée.\n");
+        } else if (tampon[4] == 's') {
+            texte_t texte = { NULL, 0, 0 };
+            texte_ajouter(&texte, "Bannis de %s:\n", salon_actuel->nom_salon);
+            verrouiller(&salon_actuel->verrou);
+            liste_bans_decrire(&salon_actuel->bans, &texte);
+            pthread_mutex_unlock(&salon_actuel->verrou);
+            envoyer_au_client(client, texte.octets, texte.longueur);
+            free(texte.octets);
+        } else {
+            int retirer = tampon[1] == 'u';
+            char *cible = tampon + (retirer ? 7 : 5);
+            char *duree = strchr(cible, ' ');
+            if (duree) *duree++ = '\0';
+            regle_ban_t regle;
+            if (analyser_regle(cible, duree ? atol(duree) : 0, &regle) < 0) {
+                envoyer_texte(client, retirer ? "Usage : /unban <pseudo|adresse[/longueur]>\n"
+                                              : "Usage : /ban <pseudo|adresse[/longueur]> [minutes]\n");
+            } else if (retirer) {
+                verrouiller(&salon_actuel->verrou);
+                size_t retirees = liste_bans_retirer(&salon_actuel->bans, &regle);
+                pthread_mutex_unlock(&salon_actuel->verrou);
+                atomic_fetch_add_explicit(&version_persistante, 1, memory_order_relaxed);
+                envoyer_texte(client, retirees ? "Bannissement levé.\n" : "Aucun bannissement pour cette cible.\n");
+            } else {
+                verrouiller(&salon_actuel->verrou);
+                liste_bans_ajouter(&salon_actuel->bans, &regle);
+                pthread_mutex_unlock(&salon_actuel->verrou);
+                atomic_fetch_add_explicit(&version_persistante, 1, memory_order_relaxed);
+                diffuser_dans_salon(salon_actuel, NULL, "%s a été banni du salon.\n", cible);
+                // Les membres visés (hors l'auteur) sont renvoyés dans le salon par défaut
+                for (int p = 0; p < nb_partitions; p++) {
+                    instantane_salon_t *membres = atomic_load_explicit(&salon_actuel->partitions[p].membres, memory_order_acquire);
+                    for (int i = membres->nb_clients - 1; i >= 0; i--) {
+                        client_t *membre = membres->blocs[i / TAILLE_BLOC_MEMBRES]->clients[i % TAILLE_BLOC_MEMBRES];
+                        if (membre != client && regle_vise(&regle, membre->pseudo, membre->adresse) &&
+                            renvoyer_dans_salon_par_defaut(membre, salon_actuel)) {
+                            envoyer_texte(membre, "Vous avez été banni du salon.\n");
+                        }
+                    }
+                }
+            }
+        }
+
+    } else if (strncmp(tampon, "/promote ", 9) == 0) {
+        // /promote <pseudo> : élever au rôle de modérateur ou admin
+        if (salon_actuel == salon_par_defaut) {
+            envoyer_texte(client, "Commande indisponible dans le salon par défaut.\n");
+        } else {
+            int mon_role = obtenir_role_dans_salon(salon_actuel, client);
+            if (mon_role < ROLE_MODERATEUR) {
+                envoyer_texte(client, "Permission refusée.\n");
+            } else {
+                char *pseudo_cible = tampon + 9;
+                int role_cible;
+                client_t *cible = trouver_membre_par_pseudo(salon_actuel, pseudo_cible, &role_cible);
+                if (cible) {
+                    if (mon_role == ROLE_MODERATEUR && role_cible < ROLE_MODERATEUR) {
+                        if (definir_role_dans_salon(salon_actuel, cible, ROLE_MODERATEUR)) {
+                            diffuser_dans_salon(salon_actuel, NULL, "%s est maintenant modérateur.\n", pseudo_cible);
+                        }
+                    } else if (mon_role == ROLE_ADMIN) {
+                        if (definir_role_dans_salon(salon_actuel, cible, ROLE_ADMIN)) {
+                            diffuser_dans_salon(salon_actuel, NULL, "%s est maintenant administrateur.\n", pseudo_cible);
+                        }
+                    }
+                }
+            }
+        }
+
+    } else if (strcmp(tampon, "/destroy") == 0) {
+        // /destroy : détruire le salon entier (admin uniquement)
+        if (salon_actuel == salon_par_defaut) {
+            envoyer_texte(client, "Impossible de détruire le salon par défaut.\n");
+        } else if (obtenir_role_dans_salon(salon_actuel, client) != ROLE_ADMIN) {
+            envoyer_texte(client, "Seul l'administrateur peut détruire ce salon.\n");
+        } else {
+            salon_t *a_detruire = salon_actuel;
+            // Plus aucune arrivée : la liste lue ensuite est définitive
+            verrouiller(&a_detruire->verrou);
+            a_detruire->detruit = 1;
+            pthread_mutex_unlock(&a_detruire->verrou);
+            retirer_salon_du_repertoire(a_detruire);
+
+            // Déplacer tous les membres dans le salon par défaut ; le salon est
+            // libéré au départ du dernier
+            for (int p = 0; p < nb_partitions; p++) {
+                instantane_salon_t *membres = atomic_load_explicit(&a_detruire->partitions[p].membres, memory_order_acquire);
+                for (int i = membres->nb_clients - 1; i >= 0; i--) {
+                    client_t *cible = membres->blocs[i / TAILLE_BLOC_MEMBRES]->clients[i % TAILLE_BLOC_MEMBRES];
+                    if (renvoyer_dans_salon_par_defaut(cible, a_detruire)) {
+                        envoyer_texte(cible, "Salon supprimé par l'administrateur. Vous êtes déplacé dans le salon par défaut.\n");
+                    }
+                }
+            }
+            printf(">>> Salon %s détruit par %s\n",
+                   a_detruire->nom_salon, client->pseudo);
+        }
+
+    } else {
+        // Diffusion d'un message normal à tout le salon
+        int role = client->role_courant;
+        message_t *message = message_formater("%s%s: %s\n", obtenir_prefixe_selon_role(role), client->pseudo, tampon);
+        message->recu_ns = derniere_lecture_ns;
+        message->sequence = atomic_fetch_add_explicit(&prochaine_sequence, 1, memory_order_relaxed);
+        diffuser_message_dans_salon(salon_actuel, message, client);
+        relayer_diffusion(salon_actuel, message, TRAME_LIGNE);
+        historique_ajouter(salon_actuel, message);
+        journal_ajouter(salon_actuel, message);
+        message_relacher(message);
+    }
+
+    rcu_lire_fin();
+    return 0;
+}
+
+/**
+ * Inscrit une connexion dans la liste de son réacteur (thread du réacteur)
+ */
+static void ajouter_connexion(client_t *client) {
+    reacteur_t *reacteur = client->reacteur;
+    client->connexion_precedente = NULL;
+    client->connexion_suivante = reacteur->connexions;
+    if (reacteur->connexions) reacteur->connexions->connexion_precedente = client;
+    reacteur->connexions = client;
+}
+
+static void retirer_connexion(client_t *client) {
+    if (client->connexion_precedente) client->connexion_precedente->connexion_suivante = client->connexion_suivante;
+    else client->reacteur->connexions = client->connexion_suivante;
+    if (client->connexion_suivante) client->connexion_suivante->connexion_precedente = client->connexion_precedente;
+}
+
+/**
+ * Retire un client de toutes les listes, ferme sa socket et le libère
+ */
+void deconnecter_client(client_t *client) {
+    compter(STAT_DECONNEXIONS, 1);
+    tracer(client, TRACE_DEPART, NULL, 0, 0);
+    if (client->reacteur) {
+        roue_desarmer(&client->reacteur->roue, &client->minuterie);
+        retirer_connexion(client);
+        oublier_envoi_differe(client);
+    }
+    if (client->etat == ETAT_CONNECTE) {
+        // Une connexion perdue garde sa session : le pseudo reste pris
+        rcu_lire_debut();
+        verrouiller(&client->verrou_salon);
+        session_t *session = preparer_session(client);
+        retirer_client_du_salon(client);
+        pthread_mutex_unlock(&client->verrou_salon);
+        rcu_lire_fin();
+
+        verrouiller(&verrou_clients);
+        client_t *dernier = liste_clients[--nb_clients_total];
+        liste_clients[client->indice_liste] = dernier;
+        dernier->indice_liste = client->indice_liste;
+        index_supprimer(&index_pseudos, client->pseudo);
+        if (session) garder_session(session, client);
+        else annoncer_pseudo(TRAME_PSEUDO_LIBRE, client->pseudo);
+        pthread_mutex_unlock(&verrou_clients);
+        if (!session) oublier_roles(client->jeton);
+    }
+
+    // Une diffusion peut encore tenir ce client : plus aucune écriture après
+    // la fermeture (le descripteur pourrait être réattribué), libération différée
+    verrouiller(&client->verrou_sortie);
+    client->en_erreur = 1;
+    close(client->descripteur);
+    pthread_mutex_unlock(&client->verrou_sortie);
+    rcu_retirer(client, liberer_client);
+}
+
+/*
+ * Débits. Chaque connexion, et chaque salon pour les lignes qui y sont
+ * diffusées, a un seau à jetons tenu sous la forme GCRA : une seule date,
+ * celle où le seau serait de nouveau plein (debit_prevu). Une ligne passe si
+ * cette date n'est pas en avance de plus de la tolérance, et la recule d'un
+ * intervalle. Faute de jeton la ligne attend dans le tampon d'entrée et la
+ * socket n'est plus lue : le noyau cesse de recevoir ses octets une fois ses
+ * tampons pleins et TCP freine l'émetteur, sans qu'aucune ligne soit perdue.
+ */
+
+static void armer_delais(client_t *client);
+
+/**
+ * Lit un débit « DEBIT[/RAFALE] » en lignes par seconde (0 : illimité) ;
+ * la rafale vaut par défaut le double du débit
+ * @return 0, ou -1 si la valeur est invalide
+ */
+static int analyser_debit(const char *valeur, debit_t *debit) {
+    char *fin;
+    unsigned long lignes = strtoul(valeur, &fin, 10), rafale = 2 * lignes;
+    if (fin == valeur || lignes > NS_PAR_S) return -1;
+    if (*fin == '/') {
+        const char *suite = fin + 1;
+        rafale = strtoul(suite, &fin, 10);
+        if (fin == suite || rafale < 1 || rafale > 1000000) return -1;
+    }
+    if (*fin != '\0') return -1;
+    debit->intervalle_ns = lignes ? NS_PAR_S / lignes : 0;
+    debit->tolerance_ns = lignes ? (rafale - 1) * debit->intervalle_ns : 0;
+    return 0;
+}
+
+/**
+ * Examine un seau à jetons sans le modifier
+ * @return 0 si une ligne passe (*nouveau reçoit alors la date à enregistrer),
+ *         sinon les nanosecondes à attendre
+ */
+static uint64_t examiner_seau(const debit_t *debit, uint64_t prevu, uint64_t maintenant, uint64_t *nouveau) {
+    uint64_t depart = prevu > maintenant ? prevu : maintenant;
+    if (depart - maintenant > debit->tolerance_ns) return depart - maintenant - debit->tolerance_ns;
+    *nouveau = depart + debit->intervalle_ns;
+    return 0;
+}
+
+/**
+ * Prend les jetons d'une ligne : celui de la connexion et, pour une ligne
+ * diffusée, celui du salon (disputé entre réacteurs, d'où la boucle CAS).
+ * Rien n'est consommé si l'un des deux manque.
+ * @return 0 si la ligne passe, sinon les nanosecondes à attendre
+ */
+static uint64_t prendre_jetons(client_t *client, int diffusion, uint64_t maintenant) {
+    uint64_t prevu_client = client->debit_prevu, attente;
+    if (debit_client.intervalle_ns &&
+        (attente = examiner_seau(&debit_client, client->debit_prevu, maintenant, &prevu_client)) > 0) {
+        return attente;
+    }
+    if (diffusion && debit_salon.intervalle_ns) {
+        rcu_lire_debut();
+        salon_t *salon = atomic_load(&client->salon_courant);
+        if (salon) {
+            uint64_t prevu = atomic_load_explicit(&salon->debit_prevu, memory_order_relaxed), prevu_salon;
+            do {
+                if ((attente = examiner_seau(&debit_salon, prevu, maintenant, &prevu_salon)) > 0) {
+                    rcu_lire_fin();
+                    return attente;
+                }
+            } while (!atomic_compare_exchange_weak_explicit(&salon->debit_prevu, &prevu, prevu_salon,
+                                                            memory_order_relaxed, memory_order_relaxed));
+        }
+        rcu_lire_fin();
+    }
+    client->debit_prevu = prevu_client;
+    return 0;
+}
+
+/**
+ * Applique les débits à la ligne reçue [debut, debut + longueur), avant de
+ * la traiter ; toute ligne qui n'est pas une commande paie aussi le débit du
+ * salon. Un thread par connexion s'endort jusqu'au prochain jeton ; un
+ * réacteur suspend la lecture, reprise à l'échéance de la minuterie.
+ * @return 1 si la lecture est suspendue, 0 si la ligne peut être traitée
+ */
+static int limiter_debit(client_t *client, size_t debut, size_t longueur) {
+    if (client->etat != ETAT_CONNECTE) return 0;
+    // Le début de la ligne suffit à la reconnaître, '\r' final ôté comme
+    // le fera traiter_ligne()
+    char tete[16];
+    size_t n = longueur < sizeof(tete) - 1 ? longueur : sizeof(tete) - 1;
+    for (size_t i = 0; i < n; i++) tete[i] = client->entree.octets[(debut + i) & (TAILLE_ENTREE - 1)];
+    if (n == longueur && n > 0 && tete[n - 1] == '\r') n--;
+    tete[n] = '\0';
+    int diffusion = !est_commande(tete);
+    uint64_t attente;
+    while ((attente = prendre_jetons(client, diffusion, horloge_ns())) > 0) {
+        compter(STAT_LIMITATIONS, 1);
+        if (client->reacteur) {
+            client->reprise_ns = horloge_ns() + attente;
+            armer_delais(client);
+            return 1;
+        }
+        struct timespec sommeil = { (time_t)(attente / NS_PAR_S), (long)(attente % NS_PAR_S) };
+        while (nanosleep(&sommeil, &sommeil) == -1 && errno == EINTR);
+    }
+    return 0;
+}
+
+/**
+ * Traite une ligne complète selon l'état de la connexion
+ * @return -1 si la connexion doit être fermée
+ */
+static int traiter_ligne(client_t *client, char *ligne, size_t longueur) {
+    compter(STAT_LIGNES_RECUES, 1);
+    if (longueur > 0 && ligne[longueur - 1] == '\r') ligne[--longueur] = '\0';
+    return client->etat == ETAT_PSEUDO ? traiter_pseudo(client, ligne)
+                                       : traiter_commande(client, ligne);
+}
+
+/**
+ * Traite la ligne [debut, debut + longueur) du tampon d'entrée. Une ligne
+ * d'un seul tenant est terminée sur place ; seule une ligne à cheval sur la
+ * fin du tampon circulaire est recopiée.
+ */
+static int traiter_ligne_recue(client_t *client, size_t debut, size_t longueur) {
+    tampon_entree_t *entree = &client->entree;
+    size_t position = debut & (TAILLE_ENTREE - 1);
+    if (position + longueur < TAILLE_ENTREE) {
+        char *ligne = entree->octets + position;
+        ligne[longueur] = '\0';     // écrase le '\n' (ou un octet libre)
+        return traiter_ligne(client, ligne, longueur);
+    }
+    char copie[MAX_MESSAGE];
+    size_t avant_repli = TAILLE_ENTREE - position;
+    memcpy(copie, entree->octets + position, avant_repli);
+    memcpy(copie + avant_repli, entree->octets, longueur - avant_repli);
+    copie[longueur] = '\0';
+    return traiter_ligne(client, copie, longueur);
+}
+
+/**
+ * Découpe et traite, dans l'ordre, toutes les lignes complètes du tampon
+ * d'entrée. Une ligne de MAX_MESSAGE octets ou plus est jetée au fil de sa
+ * réception, sans jamais occuper plus d'un tampon.
+ * @return -1 si la connexion doit être fermée, 1 si la lecture est suspendue
+ *         (débit dépassé, la ligne reste dans le tampon), 0 sinon
+ */
+static int decouper_lignes(client_t *client) {
+    tampon_entree_t *entree = &client->entree;
+    while (entree->examine < entree->fin) {
+        size_t position = entree->examine & (TAILLE_ENTREE - 1);
+        size_t contigu = entree->fin - entree->examine;
+        if (contigu > TAILLE_ENTREE - position) contigu = TAILLE_ENTREE - position;
+        char *saut = memchr(entree->octets + position, '\n', contigu);
+
+        if (!saut) {
+            // Ligne encore incomplète
+            entree->examine += contigu;
+            if (!entree->a_ignorer && entree->examine - entree->debut >= MAX_MESSAGE) {
+                entree->a_ignorer = 1;
+                envoyer_texte(client, "Ligne trop longue, ignorée.\n");
+            }
+            if (entree->a_ignorer) entree->debut = entree->examine;
+            continue;
+        }
+
+        size_t debut = entree->debut;
+        size_t longueur = entree->examine + (size_t)(saut - (entree->octets + position)) - debut;
+        if (!entree->a_ignorer && longueur < MAX_MESSAGE && limiter_debit(client, debut, longueur)) return 1;
+        entree->examine = entree->debut = debut + longueur + 1;
+        if (entree->a_ignorer) {
+            entree->a_ignorer = 0;
+        } else if (longueur >= MAX_MESSAGE) {
+            envoyer_texte(client, "Ligne trop longue, ignorée.\n");
+        } else if (traiter_ligne_recue(client, debut, longueur) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Prend en compte longueur octets arrivés à la fin du tampon d'entrée, puis
+ * traite les lignes complètes
+ * @return comme decouper_lignes()
+ */
+static int accueillir_octets(client_t *client, size_t longueur) {
+    compter(STAT_OCTETS_RECUS, (uint64_t)longueur);
+    derniere_lecture_ns = horloge_ns();
+    client->derniere_entree_ns = derniere_lecture_ns;
+    client->entree.fin += longueur;
+    return decouper_lignes(client);
+}
+
+/**
+ * Reçoit ce que la socket d'un client peut donner dans la place libre du
+ * tampon d'entrée (un seul readv pour les deux parties du tampon circulaire),
+ * puis traite les lignes complètes
+ * @return 1 si des octets ont été reçus, 0 si la socket est vide (EAGAIN) ou
+ *         la lecture suspendue, -1 si la connexion doit être fermée
+ */
+int recevoir_lignes(client_t *client) {
+    tampon_entree_t *entree = &client->entree;
+    if (client->reprise_ns) return 0;     // débit dépassé : la socket attend
+    if (!entree->octets) entree->octets = pool_allouer(&pool_entrees);
+
+    // Les lignes trop longues étant jetées, il reste toujours de la place
+    size_t libre = TAILLE_ENTREE - (entree->fin - entree->debut);
+    size_t position = entree->fin & (TAILLE_ENTREE - 1);
+    struct iovec morceaux[2];
+    int nb_morceaux = 1;
+    morceaux[0].iov_base = entree->octets + position;
+    morceaux[0].iov_len = libre < TAILLE_ENTREE - position ? libre : TAILLE_ENTREE - position;
+    if (morceaux[0].iov_len < libre) {
+        morceaux[1].iov_base = entree->octets;
+        morceaux[1].iov_len = libre - morceaux[0].iov_len;
+        nb_morceaux = 2;
+    }
+
+    ssize_t nb_octets = readv(client->descripteur, morceaux, nb_morceaux);
+    if (nb_octets == -1 && errno == EINTR) return 1;
+    if (nb_octets == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Plus rien en cours : le tampon retourne à la réserve
+        if (entree->debut == entree->fin) {
+            pool_rendre(&pool_entrees, entree->octets);
+            entree->octets = NULL;
+        }
+        return 0;
+    }
+    if (nb_octets == 0 && entree->fin > entree->debut && !entree->a_ignorer) {
+        // Fin de connexion : la dernière ligne n'a pas besoin de '\n'
+        traiter_ligne_recue(client, entree->debut, entree->fin - entree->debut);
+    }
+    if (nb_octets <= 0) return -1;
+
+    tracer(client, TRACE_OCTETS, morceaux, nb_morceaux, (size_t)nb_octets);
+    int resultat = accueillir_octets(client, (size_t)nb_octets);
+    return resultat < 0 ? -1 : !resultat;
+}
+
+/**
+ * Lit tout ce qui est disponible sur la socket d'un client (epoll en mode
+ * edge-triggered : il faut lire jusqu'à EAGAIN)
+ * @return -1 si la connexion doit être fermée, 0 sinon
+ */
+int lire_client(client_t *client) {
+    int resultat;
+    while ((resultat = recevoir_lignes(client)) > 0);
+    return resultat;
+}
+
+/*
+ * Délais des connexions. En mode réacteur, chaque client a une minuterie dans
+ * la roue de son réacteur, armée sur la plus proche de ses échéances ; les
+ * lectures ne font que noter leur date, l'échéance est recalculée quand la
+ * minuterie expire. En mode thread par connexion, les délais de la socket
+ * (SO_RCVTIMEO, SO_SNDTIMEO) en tiennent lieu. Les pairs disparus sans
+ * fermer la connexion sont détectés par les sondes TCP keepalive.
+ */
+
+/**
+ * Règle une socket acceptée : sondes keepalive et, en mode thread par
+ * connexion, délais de réception (inscription) et d'émission (lenteur)
+ */
+static void regler_connexion(int descripteur) {
+    if (delai_keepalive_s > 0) {
+        int un = 1, silence = (int)delai_keepalive_s;
+        int intervalle = silence / 4 > 0 ? silence / 4 : 1, nb_sondes = 4;
+        setsockopt(descripteur, SOL_SOCKET, SO_KEEPALIVE, &un, sizeof(un));
+        setsockopt(descripteur, IPPROTO_TCP, TCP_KEEPIDLE, &silence, sizeof(silence));
+        setsockopt(descripteur, IPPROTO_TCP, TCP_KEEPINTVL, &intervalle, sizeof(intervalle));
+        setsockopt(descripteur, IPPROTO_TCP, TCP_KEEPCNT, &nb_sondes, sizeof(nb_sondes));
+    }
+    if (mode_thread_par_connexion) {
+        struct timeval reception = { delai_inscription_s, 0 }, emission = { delai_lenteur_s, 0 };
+        setsockopt(descripteur, SOL_SOCKET, SO_RCVTIMEO, &reception, sizeof(reception));
+        setsockopt(descripteur, SOL_SOCKET, SO_SNDTIMEO, &emission, sizeof(emission));
+    }
+}
+
+/**
+ * Arme la minuterie d'un client sur sa plus proche échéance : fin du délai
+ * d'inscription, fin du délai d'inactivité, prochain contrôle de la sortie,
+ * reprise de la lecture suspendue
+ */
+static void armer_delais(client_t *client) {
+    uint64_t echeance = client->reprise_ns ? client->reprise_ns : UINT64_MAX;
+    if (client->etat == ETAT_PSEUDO && delai_inscription_s > 0) {
+        echeance = client->connexion_ns + delai_inscription_s * NS_PAR_S;
+    }
+    if (delai_inactivite_s > 0 && client->derniere_entree_ns + delai_inactivite_s * NS_PAR_S < echeance) {
+        echeance = client->derniere_entree_ns + delai_inactivite_s * NS_PAR_S;
+    }
+    if (delai_lenteur_s > 0 && client->controle_ns + delai_lenteur_s * NS_PAR_S < echeance) {
+        echeance = client->controle_ns + delai_lenteur_s * NS_PAR_S;
+    }
+    if (echeance != UINT64_MAX) {
+        roue_armer(&client->reacteur->roue, &client->minuterie, (echeance + NS_PAR_TIC - 1) / NS_PAR_TIC);
+    }
+}
+
+/**
+ * Contrôle la progression de la sortie d'un client, au plus une fois par
+ * délai de lenteur
+ * @return 1 si des octets attendent sans qu'aucun n'ait été écrit depuis le
+ *         contrôle précédent, où ils attendaient déjà
+ */
+static int sortie_bloquee(client_t *client, uint64_t maintenant) {
+    if (delai_lenteur_s == 0 || maintenant - client->controle_ns < delai_lenteur_s * NS_PAR_S) return 0;
+    verrouiller(&client->verrou_sortie);
+    int en_attente = client->sortie.nb_segments > 0;
+    int bloquee = en_attente && client->file_en_attente_controle && client->octets_ecrits == client->octets_ecrits_controle;
+    client->octets_ecrits_controle = client->octets_ecrits;
+    client->file_en_attente_controle = en_attente;
+    pthread_mutex_unlock(&client->verrou_sortie);
+    client->controle_ns = maintenant;
+    return bloquee;
+}
+
+/**
+ * Échéance d'un client (thread de son réacteur) : reprend la lecture
+ * suspendue dont l'heure est venue, ferme la connexion dont un délai est
+ * dépassé, sinon réarme sur l'échéance suivante
+ */
+static void expirer_client(minuterie_t *minuterie) {
+    client_t *client = (client_t *)((char *)minuterie - offsetof(client_t, minuterie));
+    uint64_t maintenant = horloge_ns();
+    if (client->reprise_ns && maintenant >= client->reprise_ns) {
+        // Les lignes en attente d'abord, puis ce que la socket a retenu
+        client->reprise_ns = 0;
+        int resultat = decouper_lignes(client);
+        if (resultat == 0) resultat = lire_client(client);
+        if (resultat < 0) {
+            deconnecter_client(client);
+            return;
+        }
+        maintenant = horloge_ns();
+    }
+    if (client->etat == ETAT_PSEUDO && delai_inscription_s > 0 &&
+        maintenant - client->connexion_ns >= delai_inscription_s * NS_PAR_S) {
+        envoyer_texte(client, "Délai d'inscription dépassé.\n");
+    } else if (delai_inactivite_s > 0 && maintenant - client->derniere_entree_ns >= delai_inactivite_s * NS_PAR_S) {
+        envoyer_texte(client, "Déconnecté pour inactivité.\n");
+    } else if (sortie_bloquee(client, maintenant)) {
+        atomic_fetch_add_explicit(&deconnexions_lenteur, 1, memory_order_relaxed);
+        printf(">>> %s déconnecté : file de sortie bloquée depuis %u s\n", client->pseudo, delai_lenteur_s);
+    } else {
+        armer_delais(client);
+        return;
+    }
+    compter(STAT_DELAIS_DEPASSES, 1);
+    deconnecter_client(client);
+}
+
+/**
+ * Connexion acceptée en mode -t, transmise à son thread
+ */
+typedef struct {
+    int descripteur;
+    uint32_t adresse;       // IPv4 du pair, ordre de l'hôte
+} connexion_acceptee_t;
+
+/**
+ * Fonction exécutée pour chaque client dans un thread séparé
+ * (modèle historique, conservé derrière l'option -t pour comparaison)
+ */
+void *gerer_un_client(void *arg) {
+    connexion_acceptee_t connexion = *(connexion_acceptee_t *)arg;
+    free(arg);  // libération de la mémoire allouée pour la connexion
+    int descripteur = connexion.descripteur;
+
+    client_t *client = creer_client(descripteur, connexion.adresse, NULL);
+    if (!client) {
+        close(descripteur);
+        return NULL;
+    }
+    tracer_arrivee(client);
+
+    // Boucle de réception : pseudo d'abord, puis commandes/messages. Une
+    // réception sans rien à lire signale un délai dépassé (SO_RCVTIMEO).
+    envoyer_texte(client, INVITE_PSEUDO);
+    int resultat, inscrit = 0;
+    while ((resultat = recevoir_lignes(client)) > 0) {
+        if (!inscrit && client->etat == ETAT_CONNECTE) {
+            inscrit = 1;
+            struct timeval reception = { delai_inactivite_s, 0 };
+            setsockopt(descripteur, SOL_SOCKET, SO_RCVTIMEO, &reception, sizeof(reception));
+        }
+    }
+    if (resultat == 0) {
+        compter(STAT_DELAIS_DEPASSES, 1);
+        envoyer_texte(client, inscrit ? "Déconnecté pour inactivité.\n" : "Délai d'inscription dépassé.\n");
+    }
+
+    // Nettoyage à la déconnexion du client
+    deconnecter_client(client);
+    return NULL;
+}
+
+/**
+ * Livre les diffusions déposées par les autres réacteurs, dans leur ordre de
+ * dépôt
+ */
+static void relever_courrier(reacteur_t *reacteur) {
+    uint64_t nb_reveils;
+    if (read(reacteur->reveil, &nb_reveils, sizeof(nb_reveils)) == -1 && errno != EAGAIN) perror("read eventfd");
+
+    // La pile entière est prise d'un coup, puis remise dans l'ordre d'arrivée
+    courrier_t *pile = atomic_exchange_explicit(&reacteur->boite, NULL, memory_order_acquire);
+    courrier_t *courriers = NULL;
+    while (pile) {
+        courrier_t *suivant = pile->suivant;
+        pile->suivant = courriers;
+        courriers = pile;
+        pile = suivant;
+    }
+
+    rcu_lire_debut();
+    while (courriers) {
+        courrier_t *courrier = courriers;
+        courriers = courrier->suivant;
+        livrer_dans_partition(&courrier->salon->partitions[reacteur->numero], courrier->message, courrier->client_exclu);
+        if (courrier->message->recu_ns) terminer_livraison(courrier->message);
+        message_relacher(courrier->message);
+        salon_relacher(courrier->salon);
+        free(courrier);
+    }
+    rcu_lire_fin();
+}
+
+/**
+ * Prend en charge une connexion acceptée par un réacteur
+ */
+static void confier_au_reacteur(reacteur_t *reacteur, int descripteur, uint32_t adresse) {
+    client_t *client = creer_client(descripteur, adresse, reacteur);
+    if (!client) {
+        close(descripteur);
+        return;
+    }
+    regler_connexion(descripteur);
+    client->connexion_ns = client->derniere_entree_ns = client->controle_ns = horloge_ns();
+    tracer_arrivee(client);
+    envoyer_texte(client, INVITE_PSEUDO);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = client;
+    if (epoll_ctl(reacteur->epoll, EPOLL_CTL_ADD, descripteur, &ev) == -1) {
+        perror("epoll_ctl");
+        close(descripteur);
+        liberer_client(client);
+        return;
+    }
+    ajouter_connexion(client);
+    armer_delais(client);
+}
+
+/**
+ * Accepte les connexions en attente sur la socket d'écoute du réacteur
+ */
+static void accepter_connexions(reacteur_t *reacteur) {
+    for (;;) {
+        struct sockaddr_in addr_client;
+        socklen_t taille = sizeof(addr_client);
+        int descripteur = accept4(reacteur->ecoute, (struct sockaddr *)&addr_client, &taille, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (descripteur == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+        uint32_t adresse = ntohl(addr_client.sin_addr.s_addr);
+        if (adresse_bannie(adresse)) {
+            close(descripteur);
+            compter(STAT_CONNEXIONS_REFUSEES, 1);
+            continue;
+        }
+        compter(STAT_CONNEXIONS, 1);
+        confier_au_reacteur(reacteur, descripteur, adresse);
+    }
+}
+
+// Arrêt des réacteurs le temps d'un redémarrage à chaud : ils s'immobilisent
+// entre deux tours de boucle, l'état n'est alors plus modifié que par le
+// thread qui le transmet
+static _Atomic int arret_reacteurs = 0;
+static int nb_reacteurs_arretes = 0;
+static pthread_mutex_t verrou_arret = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t condition_arret = PTHREAD_COND_INITIALIZER;
+
+static void suspendre_reacteur(void) {
+    verrouiller(&verrou_arret);
+    nb_reacteurs_arretes++;
+    pthread_cond_broadcast(&condition_arret);
+    while (atomic_load_explicit(&arret_reacteurs, memory_order_relaxed)) {
+        pthread_cond_wait(&condition_arret, &verrou_arret);
+    }
+    nb_reacteurs_arretes--;
+    pthread_mutex_unlock(&verrou_arret);
+}
+
+/**
+ * Attente maximale d'un réacteur : prochain tic de la roue, ou échéance des
+ * envois différés si elle est plus proche (à la nanoseconde, d'où epoll_pwait2)
+ * @return delai renseigné, ou NULL pour attendre sans limite
+ */
+static struct timespec *attente_reacteur(reacteur_t *reacteur, struct timespec *delai) {
+    uint64_t maintenant = horloge_ns();
+    int attente_ms = roue_attente_ms(&reacteur->roue, maintenant / 1000000);
+    uint64_t attente = attente_ms < 0 ? UINT64_MAX : (uint64_t)attente_ms * 1000000;
+    if (reacteur->nb_differes > 0) {
+        uint64_t reste = reacteur->echeance_differes_ns > maintenant ? reacteur->echeance_differes_ns - maintenant : 0;
+        if (reste < attente) attente = reste;
+    }
+    if (attente == UINT64_MAX) return NULL;
+    delai->tv_sec = (time_t)(attente / NS_PAR_S);
+    delai->tv_nsec = (long)(attente % NS_PAR_S);
+    return delai;
+}
+
+static _Atomic int pwait2_absent = 0;  // noyau antérieur à 5.11 : repli sur epoll_wait
+
+/**
+ * Attend les événements d'un réacteur jusqu'au délai donné ; epoll_pwait2
+ * quand le noyau le connaît, sinon epoll_wait au milliseconde supérieur
+ * @return nombre d'événements, ou -1 avec errno
+ */
+static int attendre_evenements(reacteur_t *reacteur, struct epoll_event *evenements, const struct timespec *delai) {
+    if (!atomic_load_explicit(&pwait2_absent, memory_order_relaxed)) {
+        int nb = epoll_pwait2(reacteur->epoll, evenements, MAX_EVENEMENTS, delai, NULL);
+        if (nb != -1 || errno != ENOSYS) return nb;
+        atomic_store_explicit(&pwait2_absent, 1, memory_order_relaxed);
+    }
+    int attente_ms = -1;
+    if (delai) {
+        uint64_t ns = (uint64_t)delai->tv_sec * NS_PAR_S + (uint64_t)delai->tv_nsec;
+        uint64_t ms = (ns + 999999) / 1000000;
+        attente_ms = ms > INT_MAX ? INT_MAX : (int)ms;
+    }
+    return epoll_wait(reacteur->epoll, evenements, MAX_EVENEMENTS, attente_ms);
+}
+
+/**
+ * Boucle d'événements d'un réacteur : chaque connexion qui lui est confiée
+ * avance par lectures et écritures non bloquantes
+ */
+void *boucle_reacteur(void *arg) {
+    reacteur_t *reacteur = arg;
+    struct epoll_event evenements[MAX_EVENEMENTS];
+    reacteur_courant = reacteur;
+
+    for (;;) {
+        if (atomic_load_explicit(&arret_reacteurs, memory_order_acquire)) suspendre_reacteur();
+        struct timespec delai;
+        int nb = attendre_evenements(reacteur, evenements, attente_reacteur(reacteur, &delai));
+        if (nb == -1) {
+            if (errno == EINTR) continue;
+            perror(atomic_load_explicit(&pwait2_absent, memory_order_relaxed) ? "epoll_wait" : "epoll_pwait2");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < nb; i++) {
+            if (evenements[i].data.ptr == &reacteur->ecoute) {
+                accepter_connexions(reacteur);
+                continue;
+            }
+            if (evenements[i].data.ptr == &reacteur->reveil) {
+                relever_courrier(reacteur);
+                continue;
+            }
+
+            client_t *client = evenements[i].data.ptr;
+            uint32_t ev = evenements[i].events;
+            int a_fermer = 0;
+
+            if (ev & EPOLLOUT) {
+                a_fermer = vider_sortie(client) < 0;
+            }
+            if (!a_fermer && (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                a_fermer = lire_client(client) < 0;
+            }
+            if (a_fermer) {
+                deconnecter_client(client);
+            }
+        }
+        roue_avancer(&reacteur->roue, horloge_ns() / NS_PAR_TIC, expirer_client);
+        if (reacteur->nb_differes > 0 && horloge_ns() >= reacteur->echeance_differes_ns) {
+            ecrire_envois_differes(reacteur);
+        }
+        vider_trace();
+    }
+    return NULL;
+}
+
+/**
+ * Ouvre une socket d'écoute TCP sur le port donné. Avec SO_REUSEPORT,
+ * plusieurs sockets partagent le port et le noyau répartit les connexions.
+ */
+static int ouvrir_socket_ecoute(unsigned short port, int port_partage) {
+    int descripteur = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | (port_partage ? SOCK_NONBLOCK : 0), 0);
+    if (descripteur == -1) {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+
+    // Autoriser la réutilisation rapide de l'adresse
+    int opt = 1;
+    setsockopt(descripteur, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (port_partage && setsockopt(descripteur, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt SO_REUSEPORT");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_in adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sin_family = AF_INET;
+    adresse.sin_port = htons(port);
+    adresse.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(descripteur, (struct sockaddr *)&adresse, sizeof(adresse)) == -1) {
+        perror("bind"); close(descripteur); exit(EXIT_FAILURE);
+    }
+    if (listen(descripteur, SOMAXCONN) == -1) {
+        perror("listen"); close(descripteur); exit(EXIT_FAILURE);
+    }
+    return descripteur;
+}
+
+/**
+ * Ajoute un descripteur propre au réacteur (écoute, réveil) à son epoll
+ */
+static void surveiller(reacteur_t *reacteur, int *descripteur) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = descripteur;
+    if (epoll_ctl(reacteur->epoll, EPOLL_CTL_ADD, *descripteur, &ev) == -1) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Crée les réacteurs, chacun avec sa socket d'écoute (héritée d'un
+ * redémarrage à chaud s'il y en a) et sa boîte aux lettres
+ */
+void preparer_reacteurs(int nombre, unsigned short port, const int *ecoutes, int nb_ecoutes) {
+    for (int i = 0; i < nombre; i++) {
+        reacteur_t *reacteur = &liste_reacteurs[i];
+        reacteur->numero = i;
+        reacteur->epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (reacteur->epoll == -1) {
+            perror("epoll_create1");
+            exit(EXIT_FAILURE);
+        }
+        reacteur->reveil = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (reacteur->reveil == -1) {
+            perror("eventfd");
+            exit(EXIT_FAILURE);
+        }
+        atomic_init(&reacteur->boite, NULL);
+        roue_initialiser(&reacteur->roue, horloge_ns() / NS_PAR_TIC);
+        reacteur->connexions = NULL;
+        reacteur->ecoute = i < nb_ecoutes ? ecoutes[i] : ouvrir_socket_ecoute(port, 1);
+        surveiller(reacteur, &reacteur->ecoute);
+        surveiller(reacteur, &reacteur->reveil);
+    }
+    // Sockets d'écoute héritées en trop (moins de réacteurs qu'avant)
+    for (int i = nombre; i < nb_ecoutes; i++) close(ecoutes[i]);
+    nb_reacteurs = nombre;
+}
+
+/**
+ * Démarre les threads des réacteurs, une fois toutes les boîtes prêtes
+ */
+void lancer_reacteurs(void) {
+    for (int i = 0; i < nb_reacteurs; i++) {
+        reacteur_t *reacteur = &liste_reacteurs[i];
+        if (pthread_create(&reacteur->thread, NULL, boucle_reacteur, reacteur) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(reacteur->thread);
+    }
+}
+
+/**
+ * Exécute une commande de la socket d'administration : « ban <cible>
+ * [minutes] », « unban <cible> », « bans » ; toute autre ligne (ou aucune)
+ * demande l'état complet du serveur
+ */
+static void executer_administration(char *ligne, texte_t *texte) {
+    ligne[strcspn(ligne, "\r\n")] = '\0';
+    if (strncmp(ligne, "ban ", 4) == 0 || strncmp(ligne, "unban ", 6) == 0) {
+        int retirer = ligne[0] == 'u';
+        char *cible = ligne + (retirer ? 6 : 4);
+        char *duree = strchr(cible, ' ');
+        if (duree) *duree++ = '\0';
+        if (modifier_ban_serveur(cible, duree ? atol(duree) : 0, retirer) < 0) {
+            texte_ajouter(texte, retirer ? "Aucun bannissement pour %s.\n" : "Cible invalide : %s\n", cible);
+        } else {
+            texte_ajouter(texte, retirer ? "%s débanni(e).\n" : "%s banni(e) du serveur.\n", cible);
+            printf(">>> %s %s du serveur (administration)\n", cible, retirer ? "débanni(e)" : "banni(e)");
+        }
+    } else if (strcmp(ligne, "bans") == 0) {
+        texte_ajouter(texte, "Bannis du serveur:\n");
+        verrouiller(&verrou_bans);
+        liste_bans_decrire(&bans_serveur, texte);
+        pthread_mutex_unlock(&verrou_bans);
+    } else {
+        rediger_statistiques(texte, SIZE_MAX);
+    }
+}
+
+/**
+ * Socket d'administration : chaque connexion peut envoyer une commande sur sa
+ * première ligne ; sans commande dans le délai, elle reçoit l'état complet du
+ * serveur. La réponse écrite, la connexion est fermée (socat ou nc -U).
+ */
+static void *boucle_administration(void *arg) {
+    int ecoute = *(int *)arg;
+    free(arg);
+    const struct timeval attente_commande = { 0, DELAI_COMMANDE_ADMINISTRATION_MS * 1000 };
+    for (;;) {
+        int descripteur = accept4(ecoute, NULL, NULL, SOCK_CLOEXEC);
+        if (descripteur == -1) {
+            if (errno != EINTR && errno != ECONNABORTED) perror("accept administration");
+            continue;
+        }
+        // Lecture de la commande, bornée dans le temps pour les simples lecteurs
+        setsockopt(descripteur, SOL_SOCKET, SO_RCVTIMEO, &attente_commande, sizeof(attente_commande));
+        char ligne[MAX_MESSAGE];
+        size_t lu = 0;
+        while (lu < sizeof(ligne) - 1 && !memchr(ligne, '\n', lu)) {
+            ssize_t n = read(descripteur, ligne + lu, sizeof(ligne) - 1 - lu);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break;
+            lu += (size_t)n;
+        }
+        ligne[lu] = '\0';
+
+        texte_t texte = { NULL, 0, 0 };
+        executer_administration(ligne, &texte);
+        size_t ecrit = 0;
+        while (ecrit < texte.longueur) {
+            ssize_t n = write(descripteur, texte.octets + ecrit, texte.longueur - ecrit);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break;
+            ecrit += (size_t)n;
+        }
+        free(texte.octets);
+        close(descripteur);
+    }
+    return NULL;
+}
+
+/**
+ * Ouvre la socket Unix d'administration et démarre son thread
+ */
+void demarrer_administration(const char *chemin) {
+    struct sockaddr_un adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+    if (strlen(chemin) >= sizeof(adresse.sun_path)) {
+        fprintf(stderr, "%s : chemin trop long\n", chemin);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(adresse.sun_path, chemin);
+
+    int *ecoute = malloc(sizeof(int));
+    if (!ecoute) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    *ecoute = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(chemin);     // socket laissée par une exécution précédente
+    if (*ecoute == -1 || bind(*ecoute, (struct sockaddr *)&adresse, sizeof(adresse)) == -1 || listen(*ecoute, 16) == -1) {
+        perror(chemin);
+        exit(EXIT_FAILURE);
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, boucle_administration, ecoute) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(thread);
+}
+
+/*
+ * Thread de fédération : il accepte les liens des autres nœuds (-F), ouvre et
+ * rétablit ceux qu'on lui a désignés (-L), écrit les trames déposées et traite
+ * celles reçues. Un pseudo annoncé par deux nœuds à la fois reste à celui dont
+ * l'identifiant est le plus petit : l'autre déconnecte son client, chaque nœud
+ * appliquant la même règle sans se concerter.
+ */
+
+typedef struct pair {
+    const char *nom;                // tel que donné à -L
+    struct sockaddr_in adresse;
+    lien_t *lien;                   // NULL tant qu'aucun lien n'est ouvert
+    uint64_t prochain_essai_ns;
+} pair_t;
+
+static pair_t pairs[MAX_PAIRS];
+static int nb_pairs = 0;
+static unsigned short port_federation = 0;
+static char secret_grappe[MAX_SECRET];
+static size_t longueur_secret = 0;      // 0 : aucun secret, fédération refusée
+static int epoll_federation = -1;
+static int ecoute_federation = -1;
+static lien_t **liens = NULL;           // tous les liens, établis ou non (thread de fédération seul)
+static size_t nb_liens = 0;
+static size_t capacite_liens = 0;
+
+/**
+ * Ajoute un pair désigné par HOTE:PORT (option -L)
+ * @return 0, ou -1 si l'adresse est invalide ou les pairs trop nombreux
+ */
+int ajouter_pair(const char *designation) {
+    const char *deux_points = strrchr(designation, ':');
+    char hote[256];
+    if (nb_pairs == MAX_PAIRS || !deux_points || deux_points == designation ||
+        (size_t)(deux_points - designation) >= sizeof(hote)) {
+        return -1;
+    }
+    memcpy(hote, designation, (size_t)(deux_points - designation));
+    hote[deux_points - designation] = '\0';
+
+    struct addrinfo indications, *resultat;
+    memset(&indications, 0, sizeof(indications));
+    indications.ai_family = AF_INET;
+    indications.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(hote, deux_points + 1, &indications, &resultat) != 0) return -1;
+    pair_t *pair = &pairs[nb_pairs++];
+    pair->nom = designation;
+    memcpy(&pair->adresse, resultat->ai_addr, sizeof(pair->adresse));
+    pair->lien = NULL;
+    pair->prochain_essai_ns = 0;
+    freeaddrinfo(resultat);
+    return 0;
+}
+
+/**
+ * Lit le secret partagé de la grappe : première ligne du fichier (option -K)
+ * @return 0, ou -1 si le fichier est illisible ou sa première ligne vide
+ */
+int charger_secret(const char *chemin) {
+    FILE *fichier = fopen(chemin, "r");
+    if (!fichier) return -1;
+    if (!fgets(secret_grappe, sizeof(secret_grappe), fichier)) secret_grappe[0] = '\0';
+    fclose(fichier);
+    longueur_secret = strcspn(secret_grappe, "\r\n");
+    secret_grappe[longueur_secret] = '\0';
+    return longueur_secret ? 0 : -1;
+}
+
+/**
+ * Condamne un lien : il n'est plus publié et sera fermé à la fin du tour
+ */
+static void condamner_lien(lien_t *lien) {
+    verrouiller(&lien->verrou);
+    lien->en_erreur = 1;
+    pthread_mutex_unlock(&lien->verrou);
+}
+
+/**
+ * Publie la liste des liens établis et non condamnés ; l'ancienne est libérée
+ * quand plus aucune diffusion ne peut la parcourir
+ */
+static void publier_liens(void) {
+    liste_liens_t *publiee = malloc(sizeof(liste_liens_t) + nb_liens * sizeof(lien_t *));
+    if (!publiee) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    publiee->nb = 0;
+    for (size_t i = 0; i < nb_liens; i++) {
+        verrouiller(&liens[i]->verrou);
+        if (liens[i]->identifiant_pair && !liens[i]->en_erreur) publiee->liens[publiee->nb++] = liens[i];
+        pthread_mutex_unlock(&liens[i]->verrou);
+    }
+    liste_liens_t *ancienne = atomic_exchange_explicit(&liens_etablis, publiee, memory_order_acq_rel);
+    if (ancienne != &aucun_lien) rcu_retirer(ancienne, free);
+}
+
+/**
+ * Crée un lien sur une socket non bloquante ; notre BONJOUR est la première
+ * trame en file
+ */
+static lien_t *creer_lien(int descripteur, int pair, int connecte) {
+    lien_t *lien = calloc(1, sizeof(lien_t));
+    if (!lien) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    lien->descripteur = descripteur;
+    lien->pair = pair;
+    lien->connecte = connecte;
+    pthread_mutex_init(&lien->verrou, NULL);
+    int un = 1;
+    setsockopt(descripteur, IPPROTO_TCP, TCP_NODELAY, &un, sizeof(un));
+
+    char bonjour[12];
+    uint32_t version = htonl(VERSION_FEDERATION);
+    uint64_t identifiant = htobe64(identifiant_noeud);
+    memcpy(bonjour, &version, sizeof(version));
+    memcpy(bonjour + 4, &identifiant, sizeof(identifiant));
+    file_ajouter(&lien->sortie, trame_construire(TRAME_BONJOUR, bonjour, sizeof(bonjour), secret_grappe, longueur_secret), 0);
+
+    struct epoll_event evenement = { EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, { .ptr = lien } };
+    if (epoll_ctl(epoll_federation, EPOLL_CTL_ADD, descripteur, &evenement) == -1) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+    liens = reserver_place(liens, nb_liens, &capacite_liens, sizeof(lien_t *));
+    liens[nb_liens++] = lien;
+    return lien;
+}
+
+static void liberer_lien(void *objet) {
+    lien_t *lien = objet;
+    file_vider(&lien->sortie);
+    free(lien->entree.octets);
+    pthread_mutex_destroy(&lien->verrou);
+    free(lien);
+}
+
+/**
+ * Oublie les pseudos qu'un nœud tenait par ce lien
+ */
+static void oublier_pseudos_distants(lien_t *lien) {
+    verrouiller(&verrou_clients);
+    const char **pseudos = NULL;
+    size_t nb = 0, capacite = 0;
+    for (size_t i = 0; i < index_pseudos_distants.capacite; i++) {
+        entree_index_t *entree = &index_pseudos_distants.entrees[i];
+        if (entree->cle && (lien_t *)entree->valeur == lien) {
+            pseudos = reserver_place(pseudos, nb, &capacite, sizeof(char *));
+            pseudos[nb++] = entree->cle;
+        }
+    }
+    for (size_t i = 0; i < nb; i++) {
+        index_supprimer(&index_pseudos_distants, pseudos[i]);
+        free((char *)pseudos[i]);
+    }
+    pthread_mutex_unlock(&verrou_clients);
+    free(pseudos);
+}
+
+/**
+ * Ferme un lien ; celui d'un pair désigné sera rouvert après un délai
+ */
+static void fermer_lien(lien_t *lien) {
+    for (size_t i = 0; i < nb_liens; i++) {
+        if (liens[i] == lien) {
+            liens[i] = liens[--nb_liens];
+            break;
+        }
+    }
+    if (lien->identifiant_pair) {
+        publier_liens();
+        oublier_pseudos_distants(lien);
+        printf(">>> Lien de fédération avec le nœud %016llx perdu\n", (unsigned long long)lien->identifiant_pair);
+    }
+    if (lien->pair >= 0) {
+        pair_t *pair = &pairs[lien->pair];
+        pair->lien = NULL;
+        if (pair->prochain_essai_ns != UINT64_MAX) pair->prochain_essai_ns = horloge_ns() + DELAI_RECONNEXION_MS * 1000000ULL;
+    }
+    close(lien->descripteur);
+    rcu_retirer(lien, liberer_lien);
+}
+
+/**
+ * Lance la connexion non bloquante vers un pair désigné
+ */
+static void ouvrir_lien_sortant(int indice) {
+    pair_t *pair = &pairs[indice];
+    int descripteur = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (descripteur == -1) {
+        perror("socket");
+        pair->prochain_essai_ns = horloge_ns() + DELAI_RECONNEXION_MS * 1000000ULL;
+        return;
+    }
+    int resultat = connect(descripteur, (struct sockaddr *)&pair->adresse, sizeof(pair->adresse));
+    if (resultat == -1 && errno != EINPROGRESS) {
+        close(descripteur);
+        pair->prochain_essai_ns = horloge_ns() + DELAI_RECONNEXION_MS * 1000000ULL;
+        return;
+    }
+    pair->lien = creer_lien(descripteur, indice, resultat == 0);
+}
+
+/**
+ * Accepte les liens ouverts par les autres nœuds
+ */
+static void accepter_liens(void) {
+    for (;;) {
+        int descripteur = accept4(ecoute_federation, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (descripteur == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept fédération");
+            return;
+        }
+        creer_lien(descripteur, -1, 1);
+    }
+}
+
+/**
+ * Déconnecte un client local dont le pseudo revient à un autre nœud
+ * (verrou_clients tenu)
+ */
+static void evincer_client(client_t *client) {
+    envoyer_texte(client, "Pseudo pris sur un autre serveur de la grappe, reconnectez-vous sous un autre nom.\n");
+    verrouiller(&client->verrou_sortie);
+    client->sans_reprise = 1;
+    if (!client->en_erreur) abandonner_sortie(client);
+    pthread_mutex_unlock(&client->verrou_sortie);
+}
+
+/**
+ * Enregistre un pseudo annoncé par un nœud (verrou_clients tenu)
+ */
+static void noter_pseudo_distant(lien_t *lien, const char *pseudo) {
+    entree_index_t *local = index_chercher(&index_pseudos, pseudo);
+    entree_index_t *garde = index_chercher(&index_sessions_pseudos, pseudo);
+    if (local || garde) {
+        // Notre client (ou sa session) garde son pseudo : l'autre nœud évince le sien
+        if (identifiant_noeud < lien->identifiant_pair) return;
+        if (local) evincer_client((client_t *)local->valeur);
+        else expirer_session((session_t *)garde->valeur);
+    }
+    entree_index_t *distant = index_chercher(&index_pseudos_distants, pseudo);
+    if (distant) {
+        if (lien->identifiant_pair <= ((lien_t *)distant->valeur)->identifiant_pair) distant->valeur = (uintptr_t)lien;
+        return;
+    }
+    char *copie = strdup(pseudo);
+    if (!copie) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    index_inserer(&index_pseudos_distants, copie, (uintptr_t)lien);
+}
+
+/**
+ * Oublie un pseudo libéré par le nœud qui le tenait (verrou_clients tenu)
+ */
+static void oublier_pseudo_distant(lien_t *lien, const char *pseudo) {
+    entree_index_t *distant = index_chercher(&index_pseudos_distants, pseudo);
+    if (!distant || (lien_t *)distant->valeur != lien) return;
+    char *copie = (char *)distant->cle;
+    index_supprimer(&index_pseudos_distants, copie);
+    free(copie);
+}
+
+/**
+ * Traite le BONJOUR d'un pair : le lien est publié, puis reçoit nos pseudos
+ * @return -1 si le lien doit être fermé
+ */
+static int accueillir_pair(lien_t *lien, const char *charge, size_t longueur) {
+    uint32_t version;
+    uint64_t identifiant;
+    if (longueur < sizeof(version) + sizeof(identifiant) || lien->identifiant_pair) return -1;
+    memcpy(&version, charge, sizeof(version));
+    memcpy(&identifiant, charge + sizeof(version), sizeof(identifiant));
+    version = ntohl(version);
+    identifiant = be64toh(identifiant);
+    if (version != VERSION_FEDERATION || identifiant == 0) {
+        fprintf(stderr, ">>> Lien de fédération refusé : protocole %u (attendu %u)\n", version, VERSION_FEDERATION);
+        return -1;
+    }
+    // Comparaison en temps constant : la durée ne dit rien du secret
+    const char *secret = charge + sizeof(version) + sizeof(identifiant);
+    unsigned char difference = longueur - sizeof(version) - sizeof(identifiant) != longueur_secret;
+    for (size_t i = 0; !difference && i < longueur_secret; i++) difference |= (unsigned char)(secret[i] ^ secret_grappe[i]);
+    if (difference) {
+        fprintf(stderr, ">>> Lien de fédération refusé : secret de la grappe invalide\n");
+        return -1;
+    }
+    if (identifiant == identifiant_noeud) {
+        if (lien->pair >= 0) {
+            fprintf(stderr, ">>> %s désigne ce nœud lui-même : ignoré\n", pairs[lien->pair].nom);
+            pairs[lien->pair].prochain_essai_ns = UINT64_MAX;
+        }
+        return -1;
+    }
+
+    // Deux liens vers le même nœud (désignés des deux côtés, ou remplaçant
+    // d'un redémarrage à chaud) : les deux nœuds gardent celui ouvert par le
+    // plus petit identifiant, le plus récent à égalité
+    uint64_t ouvreur = lien->pair >= 0 ? identifiant_noeud : identifiant;
+    for (size_t i = 0; i < nb_liens; i++) {
+        lien_t *autre = liens[i];
+        if (autre == lien || autre->identifiant_pair != identifiant) continue;
+        if ((autre->pair >= 0 ? identifiant_noeud : identifiant) < ouvreur) return -1;
+        condamner_lien(autre);
+    }
+    lien->identifiant_pair = identifiant;
+    publier_liens();
+    printf(">>> Lien de fédération établi avec le nœud %016llx\n", (unsigned long long)identifiant);
+
+    // Après la publication : une inscription concurrente est dans cette liste
+    // ou s'annonce elle-même
+    verrouiller(&verrou_clients);
+    for (size_t i = 0; i < nb_clients_total; i++) {
+        message_t *trame = trame_construire(TRAME_PSEUDO_PRIS, liste_clients[i]->pseudo, strlen(liste_clients[i]->pseudo), NULL, 0);
+        lien_deposer(lien, trame);
+        message_relacher(trame);
+    }
+    for (session_t *session = premiere_session; session; session = session->suivante) {
+        message_t *trame = trame_construire(TRAME_PSEUDO_PRIS, session->pseudo, strlen(session->pseudo), NULL, 0);
+        lien_deposer(lien, trame);
+        message_relacher(trame);
+    }
+    pthread_mutex_unlock(&verrou_clients);
+    return 0;
+}
+
+/**
+ * Livre à nos membres une diffusion relayée par un autre nœud ; un salon
+ * sans membre ici n'existe pas et la diffusion s'arrête là
+ * @return -1 si la trame est mal formée
+ */
+static int livrer_trame(int type, const char *charge, size_t longueur) {
+    size_t longueur_nom = longueur ? (unsigned char)charge[0] : 0;
+    if (longueur_nom == 0 || longueur_nom >= MAX_NOM_SALON || longueur <= 1 + longueur_nom) return -1;
+    char nom[MAX_NOM_SALON];
+    memcpy(nom, charge + 1, longueur_nom);
+    nom[longueur_nom] = '\0';
+
+    rcu_lire_debut();
+    verrouiller(&verrou_salons);
+    salon_t *salon = trouver_salon(nom);
+    pthread_mutex_unlock(&verrou_salons);
+    if (salon) {
+        message_t *message = message_copier(charge + 1 + longueur_nom, longueur - 1 - longueur_nom);
+        if (type == TRAME_LIGNE) message->sequence = atomic_fetch_add_explicit(&prochaine_sequence, 1, memory_order_relaxed);
+        diffuser_message_dans_salon(salon, message, NULL);
+        if (type == TRAME_LIGNE) historique_ajouter(salon, message);
+        message_relacher(message);
+    }
+    rcu_lire_fin();
+    return 0;
+}
+
+/**
+ * Traite une trame reçue d'un pair
+ * @return -1 si le lien doit être fermé
+ */
+static int traiter_trame(lien_t *lien, int type, const char *charge, size_t longueur) {
+    if (type == TRAME_BONJOUR) return accueillir_pair(lien, charge, longueur);
+    if (!lien->identifiant_pair) return -1;
+    switch (type) {
+        case TRAME_PSEUDO_PRIS:
+        case TRAME_PSEUDO_LIBRE: {
+            char pseudo[MAX_PSEUDO];
+            if (longueur == 0 || longueur >= MAX_PSEUDO) return -1;
+            memcpy(pseudo, charge, longueur);
+            pseudo[longueur] = '\0';
+            verrouiller(&verrou_clients);
+            if (type == TRAME_PSEUDO_PRIS) noter_pseudo_distant(lien, pseudo);
+            else oublier_pseudo_distant(lien, pseudo);
+            pthread_mutex_unlock(&verrou_clients);
+            return 0;
+        }
+        case TRAME_LIGNE:
+        case TRAME_AVIS:
+            return livrer_trame(type, charge, longueur);
+        default:
+            return 0;   // trame d'une version plus récente : ignorée
+    }
+}
+
+/**
+ * Lit tout ce que le pair a envoyé et traite les trames complètes
+ * @return -1 si le lien doit être fermé
+ */
+static int lire_lien(lien_t *lien) {
+    char morceau[65536];
+    for (;;) {
+        ssize_t n = read(lien->descripteur, morceau, sizeof(morceau));
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n <= 0) return -1;
+        texte_copier(&lien->entree, morceau, (size_t)n);
+
+        texte_t *entree = &lien->entree;
+        size_t position = 0;
+        while (entree->longueur - position >= sizeof(uint32_t)) {
+            uint32_t longueur;
+            memcpy(&longueur, entree->octets + position, sizeof(longueur));
+            longueur = ntohl(longueur);
+            if (longueur == 0 || longueur > MAX_TRAME - sizeof(uint32_t)) return -1;
+            if (entree->longueur - position - sizeof(uint32_t) < longueur) break;
+            const char *trame = entree->octets + position + sizeof(uint32_t);
+            if (traiter_trame(lien, (unsigned char)trame[0], trame + 1, longueur - 1) < 0) return -1;
+            position += sizeof(uint32_t) + longueur;
+        }
+        memmove(entree->octets, entree->octets + position, entree->longueur - position);
+        entree->longueur -= position;
+    }
+}
+
+/**
+ * Écrit les trames en attente d'un lien, plusieurs par writev()
+ * @return -1 si le lien doit être fermé
+ */
+static int ecrire_lien(lien_t *lien) {
+    verrouiller(&lien->verrou);
+    int resultat = lien->en_erreur ? -1 : 0;
+    while (resultat == 0 && lien->connecte && lien->sortie.nb_segments > 0) {
+        struct iovec iov[MAX_IOV];
+        int nb_iov = file_morceaux(&lien->sortie, iov);
+        ssize_t n = writev(lien->descripteur, iov, nb_iov);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) resultat = -1;
+        else file_consommer(&lien->sortie, (size_t)n);
+    }
+    pthread_mutex_unlock(&lien->verrou);
+    return resultat;
+}
+
+static void *boucle_federation(void *arg) {
+    (void)arg;
+    struct epoll_event evenements[MAX_EVENEMENTS];
+    for (;;) {
+        if (atomic_load_explicit(&arret_reacteurs, memory_order_acquire)) suspendre_reacteur();
+        uint64_t maintenant = horloge_ns();
+        for (int i = 0; i < nb_pairs; i++) {
+            if (!pairs[i].lien && maintenant >= pairs[i].prochain_essai_ns) ouvrir_lien_sortant(i);
+        }
+
+        int nb = epoll_wait(epoll_federation, evenements, MAX_EVENEMENTS, nb_pairs ? DELAI_RECONNEXION_MS : -1);
+        if (nb == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < nb; i++) {
+            if (evenements[i].data.ptr == &ecoute_federation) {
+                accepter_liens();
+                continue;
+            }
+            if (evenements[i].data.ptr == &reveil_federation) {
+                uint64_t nb_reveils;
+                if (read(reveil_federation, &nb_reveils, sizeof(nb_reveils)) == -1 && errno != EAGAIN) perror("read eventfd");
+                continue;
+            }
+            lien_t *lien = evenements[i].data.ptr;
+            uint32_t ev = evenements[i].events;
+            if (!lien->connecte && (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int erreur = 0;
+                socklen_t taille = sizeof(erreur);
+                if (getsockopt(lien->descripteur, SOL_SOCKET, SO_ERROR, &erreur, &taille) == -1 || erreur) {
+                    fermer_lien(lien);
+                    continue;
+                }
+                lien->connecte = 1;
+            }
+            if ((ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && lire_lien(lien) < 0) {
+                fermer_lien(lien);
+            }
+        }
+
+        // Trames déposées depuis le tour précédent ; liens condamnés fermés
+        for (size_t i = nb_liens; i-- > 0;) {
+            if (ecrire_lien(liens[i]) < 0) fermer_lien(liens[i]);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Ouvre l'écoute des autres nœuds (SO_REUSEPORT, pour qu'un remplaçant
+ * puisse s'y lier avant le départ de son prédécesseur) et démarre le thread
+ * de fédération
+ */
+void demarrer_federation(void) {
+    epoll_federation = epoll_create1(EPOLL_CLOEXEC);
+    reveil_federation = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_federation == -1 || reveil_federation == -1) {
+        perror("epoll/eventfd");
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event evenement = { EPOLLIN | EPOLLET, { .ptr = &reveil_federation } };
+    epoll_ctl(epoll_federation, EPOLL_CTL_ADD, reveil_federation, &evenement);
+    if (port_federation) {
+        ecoute_federation = ouvrir_socket_ecoute(port_federation, 1);
+        evenement.data.ptr = &ecoute_federation;
+        epoll_ctl(epoll_federation, EPOLL_CTL_ADD, ecoute_federation, &evenement);
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, boucle_federation, NULL) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(thread);
+    printf(">>> Nœud %016llx de la grappe : %d pair(s) désigné(s)", (unsigned long long)identifiant_noeud, nb_pairs);
+    if (port_federation) printf(", liens acceptés sur le port %d", port_federation);
+    printf("\n");
+}
+
+/*
+ * Redémarrage à chaud (mode réacteur). Sur SIGUSR2, le serveur lance son
+ * exécutable, relu sur le disque, avec les mêmes arguments, et immobilise ses
+ * réacteurs. Il transmet au remplaçant, sur une paire de sockets Unix, l'état
+ * sérialisé (bannissements, salons et leur historique, connexions avec leur
+ * salon, leur rôle et les octets en attente dans les deux sens), puis les
+ * sockets d'écoute et de connexion elles-mêmes (SCM_RIGHTS). Le noyau garde
+ * chaque connexion ouverte tant qu'un processus en tient le descripteur :
+ * l'ancien se termine dès que le remplaçant confirme la reprise, et reprend
+ * le service si celui-ci échoue.
+ */
+
+static char chemin_executable[PATH_MAX];
+static char **arguments_programme;
+
+static void ecrire_entier(texte_t *etat, uint64_t valeur) {
+    texte_copier(etat, &valeur, sizeof(valeur));
+}
+
+static void ecrire_octets(texte_t *etat, const void *octets, size_t longueur) {
+    ecrire_entier(etat, longueur);
+    texte_copier(etat, octets, longueur);
+}
+
+static void ecrire_regle(texte_t *etat, const regle_ban_t *regle) {
+    ecrire_entier(etat, (uint64_t)regle->par_adresse);
+    ecrire_entier(etat, regle->reseau);
+    ecrire_entier(etat, (uint64_t)regle->longueur_prefixe);
+    ecrire_octets(etat, regle->pseudo, strlen(regle->pseudo));
+    ecrire_entier(etat, (uint64_t)regle->expiration);
+}
+
+// Lecture bornée de l'état reçu : un dépassement marque l'état invalide
+typedef struct lecture_etat {
+    const char *octets;
+    size_t longueur;
+    size_t position;
+    int invalide;
+} lecture_etat_t;
+
+static const char *lire_octets(lecture_etat_t *lecture, size_t longueur) {
+    if (lecture->invalide || longueur > lecture->longueur - lecture->position) {
+        lecture->invalide = 1;
+        return NULL;
+    }
+    const char *octets = lecture->octets + lecture->position;
+    lecture->position += longueur;
+    return octets;
+}
+
+static uint64_t lire_entier(lecture_etat_t *lecture) {
+    uint64_t valeur = 0;
+    const char *octets = lire_octets(lecture, sizeof(valeur));
+    if (octets) memcpy(&valeur, octets, sizeof(valeur));
+    return valeur;
+}
+
+/**
+ * Lit une chaîne dans un tableau de taille octets (terminée par '\0')
+ */
+static void lire_chaine(lecture_etat_t *lecture, char *chaine, size_t taille) {
+    size_t longueur = lire_entier(lecture);
+    const char *octets = lire_octets(lecture, longueur);
+    if (octets && longueur >= taille) lecture->invalide = 1;
+    if (lecture->invalide) longueur = 0;
+    memcpy(chaine, octets ? octets : "", longueur);
+    chaine[longueur] = '\0';
+}
+
+static void lire_regle(lecture_etat_t *lecture, regle_ban_t *regle) {
+    regle->par_adresse = (int)lire_entier(lecture);
+    regle->reseau = (uint32_t)lire_entier(lecture);
+    regle->longueur_prefixe = (int)lire_entier(lecture);
+    lire_chaine(lecture, regle->pseudo, MAX_PSEUDO);
+    regle->expiration = (time_t)lire_entier(lecture);
+}
+
+/**
+ * Écrit les rôles retenus d'un salon, chacun avec le jeton et le pseudo de
+ * son titulaire (verrou du salon tenu)
+ */
+static void ecrire_roles(texte_t *etat, salon_t *salon) {
+    ecrire_entier(etat, salon->roles_retenus.nb);
+    for (size_t i = 0; i < salon->roles_retenus.capacite; i++) {
+        entree_index_t *entree = &salon->roles_retenus.entrees[i];
+        if (!entree->cle) continue;
+        char pseudo[MAX_PSEUDO];
+        pseudo_du_titulaire(entree->cle, pseudo);
+        ecrire_octets(etat, entree->cle, strlen(entree->cle));
+        ecrire_octets(etat, pseudo, strlen(pseudo));
+        ecrire_entier(etat, entree->valeur);
+    }
+}
+
+/**
+ * Lit les bannissements puis les rôles retenus d'un salon
+ * @return le nombre de rôles lus
+ */
+static size_t lire_salon_persistant(lecture_etat_t *lecture, salon_t *salon) {
+    size_t nb_regles = lire_entier(lecture);
+    verrouiller(&salon->verrou);
+    for (size_t i = 0; i < nb_regles && !lecture->invalide; i++) {
+        regle_ban_t regle;
+        lire_regle(lecture, &regle);
+        if (!lecture->invalide) liste_bans_ajouter(&salon->bans, &regle);
+    }
+    size_t nb_roles = lire_entier(lecture);
+    for (size_t i = 0; i < nb_roles && !lecture->invalide; i++) {
+        char jeton[2 * TAILLE_JETON + 1], pseudo[MAX_PSEUDO];
+        lire_chaine(lecture, jeton, sizeof(jeton));
+        lire_chaine(lecture, pseudo, MAX_PSEUDO);
+        uint64_t role = lire_entier(lecture);
+        if (!lecture->invalide && role > ROLE_UTILISATEUR && role <= ROLE_ADMIN) noter_role(salon, jeton, pseudo, (int)role);
+    }
+    pthread_mutex_unlock(&salon->verrou);
+    return nb_roles;
+}
 
-// Structure représentant un salon de discussion
-struct salon {
-    char nom_salon[MAX_NOM_SALON];
-    client_role_t clients_dans_salon[MAX_CLIENTS];
-    int nb_clients;
-};
+static int ecrire_tout(int descripteur, const void *octets, size_t longueur) {
+    while (longueur > 0) {
+        ssize_t n = write(descripteur, octets, longueur);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        octets = (const char *)octets + n;
+        longueur -= (size_t)n;
+    }
+    return 0;
+}
 
-// Listes globales de clients et salons
-static client_t *liste_clients[MAX_CLIENTS];
-static salon_t *liste_salons[MAX_SALONS];
-static int nb_clients_total = 0;
-static int nb_salons_total = 0;
-static pthread_mutex_t mutex_global = PTHREAD_MUTEX_INITIALIZER;
-static salon_t *salon_par_defaut = NULL;
+static int lire_tout(int descripteur, void *octets, size_t longueur) {
+    while (longueur > 0) {
+        ssize_t n = read(descripteur, octets, longueur);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        octets = (char *)octets + n;
+        longueur -= (size_t)n;
+    }
+    return 0;
+}
 
 /**
- * Renvoie un préfixe selon le rôle (pour distinguer admin/modérateur)
+ * Sérialise une connexion : identité, salon et rôle, échéances, puis les
+ * octets reçus pas encore traités et ceux qui attendent d'être écrits
  */
-const char *obtenir_prefixe_selon_role(int role) {
-    switch (role) {
-        case ROLE_ADMIN: return "@";
-        case ROLE_MODERATEUR: return "#";
-        default: return "";
+static void serialiser_client(texte_t *etat, client_t *client) {
+    salon_t *salon = atomic_load(&client->salon_courant);
+    ecrire_entier(etat, client->numero);
+    ecrire_entier(etat, (uint64_t)client->etat);
+    ecrire_entier(etat, client->adresse);
+    ecrire_octets(etat, client->pseudo, client->etat == ETAT_CONNECTE ? strlen(client->pseudo) : 0);
+    ecrire_octets(etat, client->jeton, strlen(client->jeton));
+    ecrire_octets(etat, salon ? salon->nom_salon : "", salon ? strlen(salon->nom_salon) : 0);
+    ecrire_entier(etat, (uint64_t)atomic_load(&client->role_courant));
+    ecrire_entier(etat, client->connexion_ns);
+    ecrire_entier(etat, client->derniere_entree_ns);
+    ecrire_entier(etat, client->debit_prevu);
+    ecrire_entier(etat, client->reprise_ns);
+
+    tampon_entree_t *entree = &client->entree;
+    size_t recus = entree->fin - entree->debut;
+    ecrire_entier(etat, (uint64_t)entree->a_ignorer);
+    ecrire_entier(etat, recus);
+    if (recus > 0) {
+        size_t position = entree->debut & (TAILLE_ENTREE - 1);
+        size_t avant_repli = recus < TAILLE_ENTREE - position ? recus : TAILLE_ENTREE - position;
+        texte_copier(etat, entree->octets + position, avant_repli);
+        texte_copier(etat, entree->octets, recus - avant_repli);
     }
+
+    verrouiller(&client->verrou_sortie);
+    file_sortie_t *file = &client->sortie;
+    ecrire_entier(etat, (uint64_t)client->en_retard);
+    ecrire_entier(etat, client->octets_perdus);
+    ecrire_entier(etat, file->octets);
+    for (size_t i = 0; i < file->nb_segments; i++) {
+        message_t *message = file->segments[(file->tete + i) & (file->capacite - 1)].message;
+        size_t debut = i == 0 ? file->decalage : 0;
+        texte_copier(etat, message->texte + debut, message->longueur - debut);
+    }
+    pthread_mutex_unlock(&client->verrou_sortie);
 }
 
 /**
- * Recherche un salon par son nom
+ * Sérialise l'état du serveur (réacteurs immobilisés) et relève les
+ * descripteurs à transmettre : sockets d'écoute puis connexions
  */
-salon_t *trouver_salon(const char *nom) {
-    for (int i = 0; i < nb_salons_total; i++) {
-        if (strcmp(liste_salons[i]->nom_salon, nom) == 0) {
-            return liste_salons[i];
+static void serialiser_etat(texte_t *etat, int **descripteurs, size_t *nb_descripteurs) {
+    size_t capacite = 0;
+    *nb_descripteurs = 0;
+    ecrire_entier(etat, (uint64_t)nb_reacteurs);
+    for (int i = 0; i < nb_reacteurs; i++) {
+        *descripteurs = reserver_place(*descripteurs, *nb_descripteurs, &capacite, sizeof(int));
+        (*descripteurs)[(*nb_descripteurs)++] = liste_reacteurs[i].ecoute;
+    }
+    ecrire_entier(etat, identifiant_noeud);
+    ecrire_entier(etat, atomic_load(&prochaine_sequence));
+
+    verrouiller(&verrou_bans);
+    ecrire_entier(etat, bans_serveur.nb);
+    for (size_t i = 0; i < bans_serveur.nb; i++) ecrire_regle(etat, &bans_serveur.regles[i]);
+    pthread_mutex_unlock(&verrou_bans);
+
+    verrouiller(&verrou_salons);
+    ecrire_entier(etat, nb_salons_total);
+    for (size_t i = 0; i < nb_salons_total; i++) {
+        salon_t *salon = liste_salons[i];
+        ecrire_octets(etat, salon->nom_salon, strlen(salon->nom_salon));
+        verrouiller(&salon->verrou);
+        ecrire_entier(etat, salon->bans.nb);
+        for (size_t j = 0; j < salon->bans.nb; j++) ecrire_regle(etat, &salon->bans.regles[j]);
+        ecrire_roles(etat, salon);
+        pthread_mutex_unlock(&salon->verrou);
+        historique_t *historique = &salon->historique;
+        verrouiller(&historique->verrou);
+        ecrire_entier(etat, historique->nb);
+        for (size_t j = 0; j < historique->nb; j++) {
+            message_t *message = historique->messages[(historique->debut + j) % capacite_historique];
+            ecrire_entier(etat, message->sequence);
+            ecrire_octets(etat, message->texte, message->longueur);
+        }
+        pthread_mutex_unlock(&historique->verrou);
+    }
+    pthread_mutex_unlock(&verrou_salons);
+
+    // Sessions en attente de reprise, avec le temps qu'il leur reste
+    uint64_t maintenant = horloge_ns();
+    verrouiller(&verrou_clients);
+    ecrire_entier(etat, index_sessions.nb);
+    for (session_t *session = premiere_session; session; session = session->suivante) {
+        ecrire_octets(etat, session->jeton, strlen(session->jeton));
+        ecrire_octets(etat, session->pseudo, strlen(session->pseudo));
+        ecrire_octets(etat, session->salon->nom_salon, strlen(session->salon->nom_salon));
+        ecrire_entier(etat, (uint64_t)session->role);
+        ecrire_entier(etat, session->curseur);
+        ecrire_entier(etat, session->echeance_ns > maintenant ? session->echeance_ns - maintenant : 0);
+    }
+    pthread_mutex_unlock(&verrou_clients);
+
+    // Les connexions en cours de fermeture restent à l'ancien processus
+    size_t nb_connexions = 0;
+    for (int i = 0; i < nb_reacteurs; i++) {
+        for (client_t *client = liste_reacteurs[i].connexions; client; client = client->connexion_suivante) {
+            if (!client->en_erreur) nb_connexions++;
+        }
+    }
+    ecrire_entier(etat, nb_connexions);
+    for (int i = 0; i < nb_reacteurs; i++) {
+        for (client_t *client = liste_reacteurs[i].connexions; client; client = client->connexion_suivante) {
+            if (client->en_erreur) continue;
+            serialiser_client(etat, client);
+            *descripteurs = reserver_place(*descripteurs, *nb_descripteurs, &capacite, sizeof(int));
+            (*descripteurs)[(*nb_descripteurs)++] = client->descripteur;
         }
     }
-    return NULL;
 }
 
 /**
- * Recherche le rôle d'un client dans un salon donné
+ * Envoie des descripteurs par lots de MAX_DESCRIPTEURS_MESSAGE (SCM_RIGHTS)
+ * @return 0, ou -1 si le canal est rompu
  */
-int obtenir_role_dans_salon(salon_t *salon, client_t *client) {
-    for (int i = 0; i < salon->nb_clients; i++) {
-        if (salon->clients_dans_salon[i].client == client) {
-            return salon->clients_dans_salon[i].role;
+static int envoyer_descripteurs(int canal, const int *descripteurs, size_t nb) {
+    char controle[CMSG_SPACE(MAX_DESCRIPTEURS_MESSAGE * sizeof(int))];
+    for (size_t envoyes = 0; envoyes < nb;) {
+        size_t lot = nb - envoyes < MAX_DESCRIPTEURS_MESSAGE ? nb - envoyes : MAX_DESCRIPTEURS_MESSAGE;
+        char octet = 0;
+        struct iovec morceau = { &octet, 1 };
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        memset(controle, 0, sizeof(controle));
+        message.msg_iov = &morceau;
+        message.msg_iovlen = 1;
+        message.msg_control = controle;
+        message.msg_controllen = CMSG_SPACE(lot * sizeof(int));
+        struct cmsghdr *entete = CMSG_FIRSTHDR(&message);
+        entete->cmsg_level = SOL_SOCKET;
+        entete->cmsg_type = SCM_RIGHTS;
+        entete->cmsg_len = CMSG_LEN(lot * sizeof(int));
+        memcpy(CMSG_DATA(entete), descripteurs + envoyes, lot * sizeof(int));
+        if (sendmsg(canal, &message, 0) != 1) {
+            if (errno == EINTR) continue;
+            return -1;
         }
+        envoyes += lot;
     }
-    return ROLE_UTILISATEUR;
+    return 0;
 }
 
 /**
- * Crée un nouveau salon ou retourne un salon existant
+ * Reçoit nb descripteurs envoyés par envoyer_descripteurs (FD_CLOEXEC posé)
+ * @return 0, ou -1 si le canal est rompu
  */
-salon_t *obtenir_ou_creer_salon(const char *nom) {
-    salon_t *s = trouver_salon(nom);
-    if (s) return s;
-    if (nb_salons_total >= MAX_SALONS) return NULL;
-    s = malloc(sizeof(salon_t));
-    if (!s) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
+static int recevoir_descripteurs(int canal, int *descripteurs, size_t nb) {
+    char controle[CMSG_SPACE(MAX_DESCRIPTEURS_MESSAGE * sizeof(int))];
+    for (size_t recus = 0; recus < nb;) {
+        char octet;
+        struct iovec morceau = { &octet, 1 };
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &morceau;
+        message.msg_iovlen = 1;
+        message.msg_control = controle;
+        message.msg_controllen = sizeof(controle);
+        ssize_t n = recvmsg(canal, &message, MSG_CMSG_CLOEXEC);
+        if (n == -1 && errno == EINTR) continue;
+        struct cmsghdr *entete = n == 1 ? CMSG_FIRSTHDR(&message) : NULL;
+        if (!entete || entete->cmsg_type != SCM_RIGHTS || (message.msg_flags & MSG_CTRUNC)) return -1;
+        size_t lot = (entete->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (lot > nb - recus) return -1;
+        memcpy(descripteurs + recus, CMSG_DATA(entete), lot * sizeof(int));
+        recus += lot;
     }
-    strncpy(s->nom_salon, nom, MAX_NOM_SALON);
-    s->nb_clients = 0;
-    liste_salons[nb_salons_total++] = s;
-    return s;
+    return 0;
 }
 
 /**
- * Diffuse un message à tous les membres d'un salon
- * @param salon      Le salon cible
- * @param message    Le message à envoyer
- * @param desource_exclure  Descripteur à exclure (-1 pour tous)
+ * Lance le remplaçant avec les mêmes arguments ; il hérite d'un bout du
+ * canal, dont le numéro lui est donné par VARIABLE_REPRISE
+ * @return son pid, ou -1
  */
-void diffuser_message_dans_salon(salon_t *salon, const char *message, int descripteur_exclure) {
-    for (int i = 0; i < salon->nb_clients; i++) {
-        int dsock = salon->clients_dans_salon[i].client->descripteur;
-        if (descripteur_exclure < 0 || dsock != descripteur_exclure) {
-            write(dsock, message, strlen(message));
-        }
+static pid_t lancer_remplacant(int canal) {
+    extern char **environ;
+    size_t nb_variables = 0;
+    while (environ[nb_variables]) nb_variables++;
+    char **environnement = malloc((nb_variables + 2) * sizeof(char *));
+    char variable[64];
+    if (!environnement) return -1;
+    size_t nb = 0;
+    for (size_t i = 0; i < nb_variables; i++) {
+        if (strncmp(environ[i], VARIABLE_REPRISE "=", strlen(VARIABLE_REPRISE) + 1) != 0) environnement[nb++] = environ[i];
     }
+    snprintf(variable, sizeof(variable), VARIABLE_REPRISE "=%d", canal);
+    environnement[nb++] = variable;
+    environnement[nb] = NULL;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Entre fork() et exec, seulement des appels sûrs dans un processus multithread
+        fcntl(canal, F_SETFD, 0);
+        execve(chemin_executable, arguments_programme, environnement);
+        _exit(127);
+    }
+    free(environnement);
+    return pid;
 }
 
 /**
- * Ajoute un client à un salon et notifie les autres
+ * Transmet tout le service à un nouveau processus, puis termine celui-ci ;
+ * revient, réacteurs relancés, si le remplaçant n'a pas confirmé la reprise
  */
-void ajouter_client_au_salon(salon_t *salon, client_t *client) {
-    int role_initial = (salon != salon_par_defaut && salon->nb_clients == 0) ? ROLE_ADMIN : ROLE_UTILISATEUR;
-    salon->clients_dans_salon[salon->nb_clients].client = client;
-    salon->clients_dans_salon[salon->nb_clients].role = role_initial;
-    salon->nb_clients++;
-    client->salon_courant = salon;
+static void redemarrer_a_chaud(void) {
+    uint64_t debut = horloge_ns();
+    int canal[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, canal) == -1) {
+        perror("socketpair");
+        return;
+    }
+    // Le remplaçant se charge pendant que les réacteurs s'immobilisent
+    pid_t remplacant = lancer_remplacant(canal[1]);
+    close(canal[1]);
+    if (remplacant == -1) {
+        perror("fork");
+        close(canal[0]);
+        return;
+    }
+
+    // Le thread de fédération s'immobilise aussi : plus aucune diffusion
+    // relayée ne peut viser une connexion transmise
+    atomic_store_explicit(&arret_reacteurs, 1, memory_order_release);
+    uint64_t un = 1;
+    for (int i = 0; i < nb_reacteurs; i++) {
+        if (write(liste_reacteurs[i].reveil, &un, sizeof(un)) == -1) perror("write eventfd");
+    }
+    int nb_a_arreter = nb_reacteurs;
+    if (reveil_federation >= 0) {
+        nb_a_arreter++;
+        if (write(reveil_federation, &un, sizeof(un)) == -1) perror("write eventfd");
+    }
+    verrouiller(&verrou_arret);
+    while (nb_reacteurs_arretes < nb_a_arreter) pthread_cond_wait(&condition_arret, &verrou_arret);
+    pthread_mutex_unlock(&verrou_arret);
 
-    char message[MAX_MESSAGE];
-    snprintf(message, sizeof(message), "%s%s s'est connecté(e) dans %s.\n", obtenir_prefixe_selon_role(role_initial), client->pseudo, salon->nom_salon);
-    diffuser_message_dans_salon(salon, message, client->descripteur);
+    // Diffusions encore en boîte livrées ici, journal écrit jusqu'au bout
+    for (int i = 0; i < nb_reacteurs; i++) relever_courrier(&liste_reacteurs[i]);
+    for (int attente_ms = 0; atomic_load(&journal.en_attente) > 0 && attente_ms < 1000; attente_ms++) {
+        struct timespec pause_journal = { 0, 1000000L };
+        nanosleep(&pause_journal, NULL);
+    }
+    if (journal.descripteur >= 0) fdatasync(journal.descripteur);
+
+    texte_t etat = { NULL, 0, 0 };
+    int *descripteurs = NULL;
+    size_t nb_descripteurs = 0;
+    serialiser_etat(&etat, &descripteurs, &nb_descripteurs);
+    uint64_t entete[4] = { MAGIQUE_ETAT, VERSION_ETAT, etat.longueur, nb_descripteurs };
+    struct timeval attente = { DELAI_REPRISE_S, 0 };
+    setsockopt(canal[0], SOL_SOCKET, SO_RCVTIMEO, &attente, sizeof(attente));
+    setsockopt(canal[0], SOL_SOCKET, SO_SNDTIMEO, &attente, sizeof(attente));
+    char confirmation = 0;
+    int reussi = ecrire_tout(canal[0], entete, sizeof(entete)) == 0 &&
+                 ecrire_tout(canal[0], etat.octets, etat.longueur) == 0 &&
+                 envoyer_descripteurs(canal[0], descripteurs, nb_descripteurs) == 0 &&
+                 read(canal[0], &confirmation, 1) == 1;
+    free(etat.octets);
+    free(descripteurs);
+    close(canal[0]);
+
+    if (reussi) {
+        printf(">>> Service transmis au processus %d en %.1f ms (%zu descripteurs, %zu octets d'état)\n",
+               (int)remplacant, (double)(horloge_ns() - debut) / 1e6, nb_descripteurs, (size_t)entete[2]);
+        fflush(stdout);
+        _exit(EXIT_SUCCESS);
+    }
+    fprintf(stderr, ">>> Redémarrage à chaud abandonné : le processus %d n'a pas repris le service\n", (int)remplacant);
+    kill(remplacant, SIGKILL);
+    waitpid(remplacant, NULL, 0);
+    verrouiller(&verrou_arret);
+    atomic_store_explicit(&arret_reacteurs, 0, memory_order_relaxed);
+    pthread_cond_broadcast(&condition_arret);
+    pthread_mutex_unlock(&verrou_arret);
 }
 
 /**
- * Retire un client d'un salon et notifie les autres
+ * Recrée une connexion transmise, confiée au réacteur donné (avant le
+ * démarrage des threads des réacteurs)
  */
-void retirer_client_du_salon(client_t *client) {
-    salon_t *salon = client->salon_courant;
-    if (!salon) return;
+static void restaurer_client(lecture_etat_t *lecture, int descripteur, reacteur_t *reacteur) {
+    client_t *client = creer_client(descripteur, 0, reacteur);
+    char nom_salon[MAX_NOM_SALON];
+    client->numero = (uint32_t)lire_entier(lecture);
+    if (client->numero >= prochain_numero) prochain_numero = client->numero + 1;
+    client->etat = (int)lire_entier(lecture);
+    client->adresse = (uint32_t)lire_entier(lecture);
+    lire_chaine(lecture, client->pseudo, MAX_PSEUDO);
+    lire_chaine(lecture, client->jeton, sizeof(client->jeton));
+    lire_chaine(lecture, nom_salon, MAX_NOM_SALON);
+    int role = (int)lire_entier(lecture);
+    client->connexion_ns = lire_entier(lecture);
+    client->derniere_entree_ns = lire_entier(lecture);
+    client->controle_ns = horloge_ns();
+    client->debit_prevu = lire_entier(lecture);
+    client->reprise_ns = lire_entier(lecture);
+
+    client->entree.a_ignorer = (int)lire_entier(lecture);
+    size_t recus = lire_entier(lecture);
+    const char *octets = lire_octets(lecture, recus);
+    if (octets && recus > 0 && recus <= TAILLE_ENTREE) {
+        client->entree.octets = pool_allouer(&pool_entrees);
+        memcpy(client->entree.octets, octets, recus);
+        client->entree.fin = recus;
+    }
+
+    client->en_retard = (int)lire_entier(lecture);
+    client->octets_perdus = lire_entier(lecture);
+    size_t a_ecrire = lire_entier(lecture);
+    octets = lire_octets(lecture, a_ecrire);
+    if (octets && a_ecrire > 0) file_ajouter(&client->sortie, message_copier(octets, a_ecrire), 0);
+
+    if (client->etat == ETAT_CONNECTE) {
+        verrouiller(&verrou_clients);
+        liste_clients = reserver_place(liste_clients, nb_clients_total, &capacite_clients, sizeof(client_t *));
+        client->indice_liste = nb_clients_total;
+        liste_clients[nb_clients_total++] = client;
+        index_inserer(&index_pseudos, client->pseudo, (uintptr_t)client);
+        pthread_mutex_unlock(&verrou_clients);
+
+        salon_t *salon = obtenir_ou_creer_salon(nom_salon);
+        if (!salon) salon = salon_par_defaut;
+        verrouiller(&salon->verrou);
+        inserer_membre(partition_du_client(salon, client), client, role);
+        salon->nb_membres++;
+        client->role_courant = role;
+        client->salon_courant = salon;
+        pthread_mutex_unlock(&salon->verrou);
+    }
+
+    // EPOLLET signale dès l'ajout ce qui attend déjà sur la socket
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = client;
+    if (epoll_ctl(reacteur->epoll, EPOLL_CTL_ADD, descripteur, &ev) == -1) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+    ajouter_connexion(client);
+    armer_delais(client);
+}
+
+/**
+ * Recrée une session en attente de reprise ; elle est oubliée si ce processus
+ * n'en garde pas (-s 0)
+ */
+static void restaurer_session(lecture_etat_t *lecture) {
+    session_t *session = malloc(sizeof(session_t));
+    if (!session) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    char nom_salon[MAX_NOM_SALON];
+    lire_chaine(lecture, session->jeton, sizeof(session->jeton));
+    lire_chaine(lecture, session->pseudo, MAX_PSEUDO);
+    lire_chaine(lecture, nom_salon, MAX_NOM_SALON);
+    session->role = (int)lire_entier(lecture);
+    session->curseur = lire_entier(lecture);
+    session->echeance_ns = horloge_ns() + lire_entier(lecture);
+    if (delai_session_s == 0 || lecture->invalide || session->jeton[0] == '\0') {
+        free(session);
+        return;
+    }
+
+    salon_t *salon = obtenir_ou_creer_salon(nom_salon);
+    if (!salon) salon = salon_par_defaut;
+    verrouiller(&salon->verrou);
+    salon->nb_sessions++;
+    pthread_mutex_unlock(&salon->verrou);
+    session->salon = salon;
+    verrouiller(&verrou_clients);
+    ranger_session(session);
+    pthread_mutex_unlock(&verrou_clients);
+}
+
+/**
+ * Reprend le service transmis par le processus précédent sur canal :
+ * réacteurs sur les sockets d'écoute héritées, salons, puis connexions,
+ * réparties entre les réacteurs. Toute incohérence termine le processus,
+ * et le précédent continue alors de servir.
+ */
+void reprendre_service(int canal, int nombre_reacteurs, unsigned short port) {
+    uint64_t debut = horloge_ns();
+    uint64_t entete[4];
+    if (lire_tout(canal, entete, sizeof(entete)) < 0 || entete[0] != MAGIQUE_ETAT || entete[1] != VERSION_ETAT) {
+        fprintf(stderr, "Reprise impossible : état absent ou d'une version inconnue\n");
+        exit(EXIT_FAILURE);
+    }
+    lecture_etat_t lecture = { malloc(entete[2] ? entete[2] : 1), entete[2], 0, 0 };
+    int *descripteurs = malloc((entete[3] ? entete[3] : 1) * sizeof(int));
+    if (!lecture.octets || !descripteurs) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    if (lire_tout(canal, (char *)lecture.octets, lecture.longueur) < 0 ||
+        recevoir_descripteurs(canal, descripteurs, entete[3]) < 0) {
+        fprintf(stderr, "Reprise impossible : canal rompu\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t nb_ecoutes = lire_entier(&lecture);
+    if (nb_ecoutes > entete[3]) lecture.invalide = 1;
+    preparer_reacteurs(nombre_reacteurs, port, descripteurs, lecture.invalide ? 0 : (int)nb_ecoutes);
+    identifiant_noeud = lire_entier(&lecture);
+    prochaine_sequence = lire_entier(&lecture);
 
-    char message[MAX_MESSAGE];
-    snprintf(message, sizeof(message), "%s s'est déconnecté(e) de %s.\n", client->pseudo, salon->nom_salon);
-    diffuser_message_dans_salon(salon, message, client->descripteur);
+    size_t nb_bans = lire_entier(&lecture);
+    verrouiller(&verrou_bans);
+    for (size_t i = 0; i < nb_bans && !lecture.invalide; i++) {
+        regle_ban_t regle;
+        lire_regle(&lecture, &regle);
+        liste_bans_ajouter(&bans_serveur, &regle);
+    }
+    publier_prefixes_bannis();
+    pthread_mutex_unlock(&verrou_bans);
 
-    // Supprime le client de la liste du salon
-    for (int i = 0; i < salon->nb_clients; i++) {
-        if (salon->clients_dans_salon[i].client == client) {
-            salon->clients_dans_salon[i] = salon->clients_dans_salon[--salon->nb_clients];
+    size_t nb_salons = lire_entier(&lecture);
+    for (size_t i = 0; i < nb_salons && !lecture.invalide; i++) {
+        char nom[MAX_NOM_SALON];
+        lire_chaine(&lecture, nom, MAX_NOM_SALON);
+        salon_t *salon = obtenir_ou_creer_salon(nom);
+        if (!salon) {
+            lecture.invalide = 1;
             break;
         }
+        lire_salon_persistant(&lecture, salon);
+        size_t nb_messages = lire_entier(&lecture);
+        for (size_t j = 0; j < nb_messages && !lecture.invalide; j++) {
+            uint64_t sequence = lire_entier(&lecture);
+            size_t longueur = lire_entier(&lecture);
+            const char *texte = lire_octets(&lecture, longueur);
+            if (!texte) continue;
+            message_t *message = message_copier(texte, longueur);
+            message->sequence = sequence;
+            historique_ajouter(salon, message);
+            message_relacher(message);
+        }
     }
 
-    // Si le salon (hors salon par défaut) est vide, le libérer
-    if (salon != salon_par_defaut && salon->nb_clients == 0) {
-        for (int i = 0; i < nb_salons_total; i++) {
-            if (liste_salons[i] == salon) {
-                free(salon);
-                liste_salons[i] = liste_salons[--nb_salons_total];
-                break;
-            }
-        }
+    size_t nb_sessions = lire_entier(&lecture);
+    for (size_t i = 0; i < nb_sessions && !lecture.invalide; i++) {
+        restaurer_session(&lecture);
     }
-    client->salon_courant = NULL;
+
+    size_t nb_connexions = lire_entier(&lecture);
+    if (nb_connexions != entete[3] - nb_ecoutes) lecture.invalide = 1;
+    for (size_t i = 0; i < nb_connexions && !lecture.invalide; i++) {
+        restaurer_client(&lecture, descripteurs[nb_ecoutes + i], &liste_reacteurs[i % (size_t)nb_reacteurs]);
+    }
+    if (lecture.invalide) {
+        fprintf(stderr, "Reprise impossible : état incohérent\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char confirmation = 1;
+    if (ecrire_tout(canal, &confirmation, 1) < 0) {
+        fprintf(stderr, "Reprise impossible : le processus précédent ne répond plus\n");
+        exit(EXIT_FAILURE);
+    }
+    close(canal);
+    free((char *)lecture.octets);
+    free(descripteurs);
+    printf(">>> Service repris : %zu connexions, %zu salons, en %.1f ms\n",
+           nb_connexions, nb_salons, (double)(horloge_ns() - debut) / 1e6);
 }
 
+/*
+ * Cliché persistant (-c). Le répertoire des salons, leurs bannissements et
+ * leurs rôles retenus, ainsi que les bannissements du serveur, sont écrits
+ * périodiquement dans un fichier binaire versionné, au format de l'état du
+ * redémarrage à chaud. Le thread du cliché ne tient chaque verrou que le
+ * temps de recopier un salon ; le fichier est écrit à côté puis renommé, si
+ * bien qu'un cliché lu est toujours complet. Au démarrage, le fichier est
+ * projeté en mémoire et lu sur place, sans relire le journal. Un rôle retenu
+ * n'est rendu qu'au client qui présente le jeton de son titulaire.
+ *
+ * Format : MAGIQUE_CLICHE, VERSION_CLICHE, bannissements du serveur, puis
+ * nombre de salons et, pour chacun, nom, bannissements et rôles retenus
+ * (jeton, pseudo, rôle).
+ */
+
+static const char *chemin_cliche = NULL;
+static unsigned int intervalle_cliche_s = INTERVALLE_CLICHE_DEFAUT;
+
 /**
- * Vérifie si un pseudo est déjà utilisé
+ * Écrit les bannissements encore en vigueur d'une liste
  */
-int existe_deja_le_pseudo(const char *pseudo) {
-    for (int i = 0; i < nb_clients_total; i++) {
-        if (strcmp(liste_clients[i]->pseudo, pseudo) == 0) {
-            return 1;
-        }
+static void ecrire_bans(texte_t *etat, const liste_bans_t *liste, time_t maintenant) {
+    size_t nb = 0;
+    for (size_t i = 0; i < liste->nb; i++) nb += !regle_expiree(&liste->regles[i], maintenant);
+    ecrire_entier(etat, nb);
+    for (size_t i = 0; i < liste->nb; i++) {
+        if (!regle_expiree(&liste->regles[i], maintenant)) ecrire_regle(etat, &liste->regles[i]);
     }
-    return 0;
 }
 
 /**
- * Envoie la liste des salons disponibles au client
+ * Rédige le cliché : les salons sont relevés sous verrou_salons, puis
+ * recopiés un à un sous leur propre verrou (section de lecture)
  */
-void envoyer_liste_des_salons(int descripteur_client) {
-    char tampon[MAX_MESSAGE] = "Salons disponibles:\n";
-    for (int i = 0; i < nb_salons_total; i++) {
-        strcat(tampon, "- ");
-        strcat(tampon, liste_salons[i]->nom_salon);
-        strcat(tampon, "\n");
+static void rediger_cliche(texte_t *cliche, size_t *nb_salons, size_t *nb_roles) {
+    time_t maintenant = time(NULL);
+    ecrire_entier(cliche, MAGIQUE_CLICHE);
+    ecrire_entier(cliche, VERSION_CLICHE);
+    verrouiller(&verrou_bans);
+    ecrire_bans(cliche, &bans_serveur, maintenant);
+    pthread_mutex_unlock(&verrou_bans);
+
+    salon_t **salons = relever_salons(nb_salons);
+    *nb_roles = 0;
+    ecrire_entier(cliche, *nb_salons);
+    for (size_t i = 0; i < *nb_salons; i++) {
+        salon_t *salon = salons[i];
+        ecrire_octets(cliche, salon->nom_salon, strlen(salon->nom_salon));
+        verrouiller(&salon->verrou);
+        ecrire_bans(cliche, &salon->bans, maintenant);
+        ecrire_roles(cliche, salon);
+        *nb_roles += salon->roles_retenus.nb;
+        pthread_mutex_unlock(&salon->verrou);
     }
-    write(descripteur_client, tampon, strlen(tampon));
+    free(salons);
 }
 
 /**
- * Fonction exécutée pour chaque client dans un thread séparé
+ * Écrit un cliché complet à côté du fichier puis le renomme par-dessus
+ * @return 0, ou -1 en cas d'échec (l'ancien cliché reste en place)
  */
-void *gerer_un_client(void *arg) {
-    int descripteur = *(int *)arg;
-    free(arg);  // libération de la mémoire allouée pour le descripteur
-    char tampon[MAX_MESSAGE];
-    ssize_t nb_octets;
-    char pseudo[MAX_PSEUDO];
+static int ecrire_cliche(const texte_t *cliche) {
+    char provisoire[PATH_MAX];
+    if (snprintf(provisoire, sizeof(provisoire), "%s.tmp", chemin_cliche) >= (int)sizeof(provisoire)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int descripteur = open(provisoire, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descripteur == -1) return -1;
+    if (ecrire_tout(descripteur, cliche->octets, cliche->longueur) < 0 || fdatasync(descripteur) == -1) {
+        close(descripteur);
+        unlink(provisoire);
+        return -1;
+    }
+    close(descripteur);
+    return rename(provisoire, chemin_cliche);
+}
 
-    // Demander un pseudo unique
-    do {
-        write(descripteur, "Entrez votre pseudo : ", 21);
-        nb_octets = read(descripteur, pseudo, sizeof(pseudo));
-        if (nb_octets <= 0) {
-            close(descripteur);
-            return NULL;
-        }
-        pseudo[strcspn(pseudo, "\r\n")] = '\0';
+/**
+ * Thread du cliché : un nouveau cliché par intervalle, seulement si un
+ * salon, un rôle ou un bannissement a changé depuis le précédent
+ */
+static void *boucle_cliche(void *arg) {
+    (void)arg;
+    unsigned long ecrit_salons = atomic_load(&version_salons);
+    unsigned long ecrit_persistante = atomic_load(&version_persistante);
+    for (;;) {
+        struct timespec pause = { (time_t)intervalle_cliche_s, 0 };
+        nanosleep(&pause, NULL);
+        unsigned long salons = atomic_load(&version_salons);
+        unsigned long persistante = atomic_load(&version_persistante);
+        if (salons == ecrit_salons && persistante == ecrit_persistante) continue;
 
-        pthread_mutex_lock(&mutex_global);
-        if (existe_deja_le_pseudo(pseudo)) {
-            pthread_mutex_unlock(&mutex_global);
-            write(descripteur, "Pseudo déjà pris.\n", 18);
+        texte_t cliche = { NULL, 0, 0 };
+        size_t nb_salons, nb_roles;
+        rcu_lire_debut();
+        rediger_cliche(&cliche, &nb_salons, &nb_roles);
+        rcu_lire_fin();
+        if (ecrire_cliche(&cliche) == 0) {
+            ecrit_salons = salons;
+            ecrit_persistante = persistante;
         } else {
-            pthread_mutex_unlock(&mutex_global);
-            break;
+            perror(chemin_cliche);
         }
-    } while (1);
+        free(cliche.octets);
+    }
+    return NULL;
+}
 
-    // Création et ajout du client à la liste globale
-    client_t *client = malloc(sizeof(client_t));
-    if (!client) {
-		perror("malloc");
-		close(descripteur); return NULL;
-	}
-    client->descripteur = descripteur;
-    strncpy(client->pseudo, pseudo, MAX_PSEUDO);
+/**
+ * Recharge le cliché au démarrage : le fichier est projeté en mémoire et lu
+ * sur place. Un fichier absent laisse le serveur vide ; un fichier d'un
+ * autre format est ignoré.
+ */
+void charger_cliche(void) {
+    uint64_t debut = horloge_ns();
+    int descripteur = open(chemin_cliche, O_RDONLY | O_CLOEXEC);
+    if (descripteur == -1) {
+        if (errno != ENOENT) perror(chemin_cliche);
+        return;
+    }
+    struct stat etat;
+    if (fstat(descripteur, &etat) == -1 || etat.st_size == 0) {
+        close(descripteur);
+        return;
+    }
+    void *projection = mmap(NULL, (size_t)etat.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, descripteur, 0);
+    close(descripteur);
+    if (projection == MAP_FAILED) {
+        perror(chemin_cliche);
+        return;
+    }
 
-    pthread_mutex_lock(&mutex_global);
-    liste_clients[nb_clients_total++] = client;
-    ajouter_client_au_salon(salon_par_defaut, client);
-    pthread_mutex_unlock(&mutex_global);
+    lecture_etat_t lecture = { projection, (size_t)etat.st_size, 0, 0 };
+    if (lire_entier(&lecture) != MAGIQUE_CLICHE || lire_entier(&lecture) != VERSION_CLICHE) {
+        fprintf(stderr, "%s : cliché d'un format inconnu, ignoré\n", chemin_cliche);
+        munmap(projection, (size_t)etat.st_size);
+        return;
+    }
+    size_t nb_bans = lire_entier(&lecture);
+    verrouiller(&verrou_bans);
+    for (size_t i = 0; i < nb_bans && !lecture.invalide; i++) {
+        regle_ban_t regle;
+        lire_regle(&lecture, &regle);
+        if (!lecture.invalide) liste_bans_ajouter(&bans_serveur, &regle);
+    }
+    publier_prefixes_bannis();
+    pthread_mutex_unlock(&verrou_bans);
 
-    // Envoi du message de bienvenue
-    snprintf(tampon, sizeof(tampon), "Bienvenue %s dans %s !\n", client->pseudo, salon_par_defaut->nom_salon);
-    write(descripteur, tampon, strlen(tampon));
+    size_t nb_salons = lire_entier(&lecture), nb_roles = 0;
+    for (size_t i = 0; i < nb_salons && !lecture.invalide; i++) {
+        char nom[MAX_NOM_SALON];
+        lire_chaine(&lecture, nom, MAX_NOM_SALON);
+        salon_t *salon = lecture.invalide ? NULL : obtenir_ou_creer_salon(nom);
+        if (!salon) break;
+        nb_roles += lire_salon_persistant(&lecture, salon);
+    }
+    munmap(projection, (size_t)etat.st_size);
+    if (lecture.invalide) fprintf(stderr, "%s : cliché tronqué, chargé en partie\n", chemin_cliche);
+    printf(">>> Cliché %s chargé : %zu salon(s), %zu rôle(s) retenu(s), en %.2f ms\n",
+           chemin_cliche, nb_salons, nb_roles, (double)(horloge_ns() - debut) / 1e6);
+}
 
-    // Boucle de réception des commandes/messages du client
-    while ((nb_octets = read(descripteur, tampon, sizeof(tampon)-1)) > 0) {
-        tampon[nb_octets] = '\0';
-        tampon[strcspn(tampon, "\r\n")] = '\0';
+/**
+ * Lance le thread du cliché
+ */
+void demarrer_cliche(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, boucle_cliche, NULL) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(thread);
+}
 
-        pthread_mutex_lock(&mutex_global);
+/*
+ * Rejeu d'une trace (-x). Les événements sont triés par date puis passés,
+ * dans un seul thread, au même découpage de lignes et aux mêmes commandes
+ * qu'en service, en mode thread par connexion : chaque connexion rejouée
+ * écrit ses réponses dans /dev/null. Avec -v 0 le rejeu va aussi vite que
+ * possible, avec -v F il suit les dates de la trace accélérées F fois. Les
+ * limites de débit sont levées : les dates de la trace portent déjà celles
+ * du service enregistré, et un sommeil du seul thread de rejeu retarderait
+ * toutes les connexions. Le journal n'est écrit qu'avec un -j explicite.
+ */
 
-        // Gestion des différentes commandes
-        if (strcmp(tampon, "/exit") == 0) {
-            // /exit : déconnexion propre
-            pthread_mutex_unlock(&mutex_global);
-            break;
+typedef struct evenement_trace {
+    uint8_t type;
+    uint32_t numero;
+    uint64_t date_ns;
+    uint32_t longueur;
+    const char *octets;
+    size_t rang;                    // départage les événements de même date
+} evenement_trace_t;
 
-        } else if (strcmp(tampon, "/channels") == 0) {
-            // /channels : lister tous les salons
-            envoyer_liste_des_salons(descripteur);
-
-        } else if (strncmp(tampon, "/join channel", 6) == 0) {
-            // /join <salon> : quitter l'ancien salon et rejoindre (ou créer) le nouveau
-            char *nom_salon = tampon + 6;
-            retirer_client_du_salon(client);
-            salon_t *salon_cible = obtenir_ou_creer_salon(nom_salon);
-            if (salon_cible == NULL) {
-                write(descripteur, "Impossible de créer ou rejoindre le salon.\n", strlen("Impossible de créer ou rejoindre le salon.\n"));
-            } else {
-                ajouter_client_au_salon(salon_cible, client);
-                char msg_confirm[MAX_MESSAGE];
-                snprintf(msg_confirm, sizeof(msg_confirm), "Vous avez rejoint %s.\n", salon_cible->nom_salon);
-                write(descripteur, msg_confirm, strlen(msg_confirm));
-            }
-
-        }  else if (strcmp(tampon, "/date") == 0) {
-            // /date : envoyer la date et l'heure du serveur
-            time_t maintenant = time(NULL);
-            char msg_date[MAX_MESSAGE];
-            strftime(msg_date, sizeof(msg_date), "Date serveur : %d/%m/%Y %H:%M:%S\n", localtime(&maintenant));
-            write(descripteur, msg_date, strlen(msg_date));
-
-        } else if (strncmp(tampon, "/kick ", 6) == 0) {
-            // /kick <pseudo> : expulser un utilisateur du salon courant
-            if (client->salon_courant == salon_par_defaut) {
-                write(descripteur, "Commande indisponible dans le salon par défaut.\n", strlen("Commande indisponible dans le salon par défaut.\n"));
-            } else {
-                int mon_role = obtenir_role_dans_salon(client->salon_courant, client);
-                if (mon_role < ROLE_MODERATEUR) {
-                    write(descripteur, "Permission refusée.\n", strlen("Permission refusée.\n"));
-                } else {
-                    char *pseudo_cible = tampon + 6;
-                    salon_t *salon_actuel = client->salon_courant;
-                    for (int i = 0; i < salon_actuel->nb_clients; i++) {
-                        if (strcmp(salon_actuel->clients_dans_salon[i].client->pseudo, pseudo_cible) == 0) {
-                            client_t *cible = salon_actuel->clients_dans_salon[i].client;
-                            retirer_client_du_salon(cible);
-                            ajouter_client_au_salon(salon_par_defaut, cible);
-                            write(cible->descripteur, "Vous avez été expulsé du salon.\n", strlen("Vous avez été expulsé du salon.\n"));
-
-                            char annonce[MAX_MESSAGE];
-                            snprintf(annonce, sizeof(annonce), "%s a été expulsé du salon.\n", pseudo_cible);
-                            diffuser_message_dans_salon(salon_actuel, annonce, -1);
-                            break;
-                        }
-                    }
-                }
-            }
+static int comparer_evenements(const void *a, const void *b) {
+    const evenement_trace_t *x = a, *y = b;
+    if (x->date_ns != y->date_ns) return x->date_ns < y->date_ns ? -1 : 1;
+    return x->rang < y->rang ? -1 : x->rang > y->rang;
+}
 
-        } else if (strncmp(tampon, "/ban ", 5) == 0) {
-            // /ban <pseudo> : placeholder (non implémenté)
-            write(descripteur, "Fonction bannir non implémentée.\n", strlen("Fonction bannir non implémentée.\n"));
+/**
+ * Copie des octets rejoués dans le tampon d'entrée d'un client, par morceaux
+ * qui tiennent dans la place libre, et traite les lignes complètes
+ * @return -1 si la connexion doit être fermée, 0 sinon
+ */
+static int injecter_octets(client_t *client, const char *octets, size_t longueur) {
+    tampon_entree_t *entree = &client->entree;
+    if (!entree->octets) entree->octets = pool_allouer(&pool_entrees);
+    while (longueur > 0) {
+        size_t libre = TAILLE_ENTREE - (entree->fin - entree->debut);
+        size_t position = entree->fin & (TAILLE_ENTREE - 1);
+        size_t n = libre < TAILLE_ENTREE - position ? libre : TAILLE_ENTREE - position;
+        if (n > longueur) n = longueur;
+        memcpy(entree->octets + position, octets, n);
+        if (accueillir_octets(client, n) < 0) return -1;
+        octets += n;
+        longueur -= n;
+    }
+    return 0;
+}
 
-        } else if (strncmp(tampon, "/promote ", 9) == 0) {
-            // /promote <pseudo> : élever au rôle de modérateur ou admin
-            if (client->salon_courant == salon_par_defaut) {
-                write(descripteur, "Commande indisponible dans le salon par défaut.\n", strlen("Commande indisponible dans le salon par défaut.\n"));
-            } else {
-                int mon_role = obtenir_role_dans_salon(client->salon_courant, client);
-                if (mon_role < ROLE_MODERATEUR) {
-                    write(descripteur, "Permission refusée.\n", strlen("Permission refusée.\n"));
-                } else {
-                    char *pseudo_cible = tampon + 9;
-                    salon_t *salon_actuel = client->salon_courant;
-                    for (int i = 0; i < salon_actuel->nb_clients; i++) {
-                        if (strcmp(salon_actuel->clients_dans_salon[i].client->pseudo, pseudo_cible) == 0) {
-                            if (mon_role == ROLE_MODERATEUR && salon_actuel->clients_dans_salon[i].role < ROLE_MODERATEUR) {
-                                salon_actuel->clients_dans_salon[i].role = ROLE_MODERATEUR;
-                                char annonce[MAX_MESSAGE];
-                                snprintf(annonce, sizeof(annonce), "%s est maintenant modérateur.\n", pseudo_cible);
-                                diffuser_message_dans_salon(salon_actuel, annonce, -1);
-                            } else if (mon_role == ROLE_ADMIN) {
-                                salon_actuel->clients_dans_salon[i].role = ROLE_ADMIN;
-                                char annonce[MAX_MESSAGE];
-                                snprintf(annonce, sizeof(annonce), "%s est maintenant administrateur.\n", pseudo_cible);
-                                diffuser_message_dans_salon(salon_actuel, annonce, -1);
-                            }
-                            break;
-                        }
-                    }
-                }
-            }
+/**
+ * Charge le fichier de trace entier
+ * @return les événements triés par date (*nb renseigné), quitte si la trace
+ *         est illisible
+ */
+static evenement_trace_t *charger_trace(const char *chemin, texte_t *contenu, size_t *nb) {
+    int descripteur = open(chemin, O_RDONLY | O_CLOEXEC);
+    if (descripteur == -1) {
+        perror(chemin);
+        exit(EXIT_FAILURE);
+    }
+    char morceau[65536];
+    ssize_t n;
+    while ((n = read(descripteur, morceau, sizeof(morceau))) > 0) texte_copier(contenu, morceau, (size_t)n);
+    close(descripteur);
 
-        } else if (strcmp(tampon, "/destroy") == 0) {
-            // /destroy : détruire le salon entier (admin uniquement)
-            if (client->salon_courant == salon_par_defaut) {
-                write(descripteur, "Impossible de détruire le salon par défaut.\n", strlen("Impossible de détruire le salon par défaut.\n"));
-            } else if (obtenir_role_dans_salon(client->salon_courant, client) != ROLE_ADMIN) {
-                write(descripteur, "Seul l'administrateur peut détruire ce salon.\n", strlen("Seul l'administrateur peut détruire ce salon.\n"));
-            } else {
-                salon_t *a_detruire = client->salon_courant;
-                // Déplacer tous les membres dans le salon par défaut
-                for (int i = a_detruire->nb_clients - 1; i >= 0; i--) {
-                    client_t *cible = a_detruire->clients_dans_salon[i].client;
-                    retirer_client_du_salon(cible);
-                    ajouter_client_au_salon(salon_par_defaut, cible);
-                    write(cible->descripteur, "Salon supprimé par l'administrateur. Vous êtes déplacé dans le salon par défaut.\n", strlen("Salon supprimé par l'administrateur. Vous êtes déplacé dans le salon par défaut.\n"));
-                }
-                printf(">>> Salon %s détruit par %s\n",
-                       a_detruire->nom_salon, client->pseudo);
+    uint32_t entete[2];
+    if (n < 0 || contenu->longueur < sizeof(entete)) {
+        fprintf(stderr, "%s : trace illisible\n", chemin);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(entete, contenu->octets, sizeof(entete));
+    if (entete[0] != MAGIQUE_TRACE || entete[1] != VERSION_TRACE) {
+        fprintf(stderr, "%s : pas une trace de ce serveur (version %u attendue)\n", chemin, VERSION_TRACE);
+        exit(EXIT_FAILURE);
+    }
+
+    evenement_trace_t *evenements = NULL;
+    size_t capacite = 0, position = sizeof(entete);
+    const size_t taille_entete = 1 + 4 + 8 + 4;
+    *nb = 0;
+    while (contenu->longueur - position >= taille_entete) {
+        evenement_trace_t evenement;
+        const char *octets = contenu->octets + position;
+        memcpy(&evenement.type, octets, 1);
+        memcpy(&evenement.numero, octets + 1, 4);
+        memcpy(&evenement.date_ns, octets + 5, 8);
+        memcpy(&evenement.longueur, octets + 13, 4);
+        if (contenu->longueur - position - taille_entete < evenement.longueur) break;
+        evenement.octets = octets + taille_entete;
+        evenement.rang = *nb;
+        position += taille_entete + evenement.longueur;
+        if (*nb == capacite) {
+            capacite = capacite ? capacite * 2 : 1024;
+            evenements = realloc(evenements, capacite * sizeof(evenement_trace_t));
+            if (!evenements) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
             }
+        }
+        evenements[(*nb)++] = evenement;
+    }
+    if (position != contenu->longueur) {
+        fprintf(stderr, "%s : trace tronquée après %zu événements\n", chemin, *nb);
+    }
+    qsort(evenements, *nb, sizeof(evenement_trace_t), comparer_evenements);
+    return evenements;
+}
 
-        } else {
-            // Diffusion d'un message normal à tout le salon
-            int role = obtenir_role_dans_salon(client->salon_courant, client);
-            char message[MAX_MESSAGE + MAX_PSEUDO + 4];
-            snprintf(message, sizeof(message), "%s%s: %s\n", obtenir_prefixe_selon_role(role), client->pseudo, tampon);
-            diffuser_message_dans_salon(client->salon_courant, message, descripteur);
+/**
+ * Ferme une connexion rejouée ; comme en service, la dernière ligne n'a pas
+ * besoin de '\n'
+ */
+static void terminer_rejeu(index_t *connexions, client_t *client, int fin_de_flux) {
+    tampon_entree_t *entree = &client->entree;
+    if (fin_de_flux && entree->fin > entree->debut && !entree->a_ignorer) {
+        traiter_ligne_recue(client, entree->debut, entree->fin - entree->debut);
+    }
+    index_supprimer(connexions, (const void *)(uintptr_t)client->numero);
+    deconnecter_client(client);
+}
+
+/**
+ * Rejoue une trace puis affiche le débit obtenu et les statistiques
+ */
+static void rejouer_trace(const char *chemin, double facteur) {
+    texte_t contenu = { NULL, 0, 0 };
+    size_t nb;
+    evenement_trace_t *evenements = charger_trace(chemin, &contenu, &nb);
+
+    // Les numéros de la trace désignent les connexions rejouées
+    index_t connexions;
+    index_initialiser(&connexions, 0);
+    size_t nb_connexions = 0, nb_lignes = 0;
+    uint64_t debut = horloge_ns();
+    for (size_t i = 0; i < nb; i++) {
+        evenement_trace_t *evenement = &evenements[i];
+        if (facteur > 0) {
+            uint64_t echeance = debut + (uint64_t)((double)(evenement->date_ns - evenements[0].date_ns) / facteur);
+            struct timespec sommeil = { (time_t)(echeance / NS_PAR_S), (long)(echeance % NS_PAR_S) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sommeil, NULL) == EINTR);
         }
 
-        pthread_mutex_unlock(&mutex_global);
+        const void *cle = (const void *)(uintptr_t)evenement->numero;
+        entree_index_t *trouvee = index_chercher(&connexions, cle);
+        client_t *client = trouvee ? (client_t *)trouvee->valeur : NULL;
+        if (!client && evenement->type != TRACE_DEPART) {
+            // Une connexion sans arrivée (trace commencée après elle) est
+            // ouverte à son premier octet
+            uint32_t adresse = 0;
+            if (evenement->type == TRACE_ARRIVEE && evenement->longueur == sizeof(adresse)) {
+                memcpy(&adresse, evenement->octets, sizeof(adresse));
+            }
+            int descripteur = open("/dev/null", O_WRONLY | O_CLOEXEC);
+            if (descripteur == -1) {
+                perror("/dev/null");
+                exit(EXIT_FAILURE);
+            }
+            client = creer_client(descripteur, adresse, NULL);
+            client->numero = evenement->numero;
+            client->connexion_ns = client->derniere_entree_ns = client->controle_ns = horloge_ns();
+            index_inserer(&connexions, cle, (uintptr_t)client);
+            compter(STAT_CONNEXIONS, 1);
+            nb_connexions++;
+            envoyer_texte(client, INVITE_PSEUDO);
+        }
+        if (!client) continue;   // déjà fermée par le serveur
 
+        if (evenement->type == TRACE_OCTETS) {
+            for (uint32_t j = 0; j < evenement->longueur; j++) nb_lignes += evenement->octets[j] == '\n';
+            if (injecter_octets(client, evenement->octets, evenement->longueur) < 0) {
+                terminer_rejeu(&connexions, client, 0);
+            }
+        } else if (evenement->type == TRACE_DEPART) {
+            terminer_rejeu(&connexions, client, 1);
+        }
     }
 
-    // Nettoyage à la déconnexion du client
-    pthread_mutex_lock(&mutex_global);
-    retirer_client_du_salon(client);
-    for (int i = 0; i < nb_clients_total; i++) {
-        if (liste_clients[i] == client) {
-            liste_clients[i] = liste_clients[--nb_clients_total];
-            break;
+    // Connexions encore ouvertes à la fin de la trace
+    for (size_t i = 0; i < connexions.capacite; i++) {
+        while (connexions.entrees[i].cle) {
+            terminer_rejeu(&connexions, (client_t *)connexions.entrees[i].valeur, 1);
         }
     }
-    pthread_mutex_unlock(&mutex_global);
+    double duree = (double)(horloge_ns() - debut) / 1e9;
+    printf(">>> Rejeu de %s : %zu événements, %zu connexions, %zu lignes en %.3f s (%.0f lignes/s)\n",
+           chemin, nb, nb_connexions, nb_lignes, duree, duree > 0 ? (double)nb_lignes / duree : 0.0);
 
-    close(descripteur);
-    free(client);
-    return NULL;
+    texte_t texte = { NULL, 0, 0 };
+    rediger_statistiques(&texte, MAX_SALONS_STATS);
+    fwrite(texte.octets, 1, texte.longueur, stdout);
+    free(texte.octets);
+    index_liberer(&connexions);
+    free(evenements);
+    free(contenu.octets);
+}
+
+/**
+ * Affiche l'aide de la ligne de commande et quitte
+ */
+static void afficher_usage(const char *programme) {
+    fprintf(stderr, "Usage : %s [options] <port>\n", programme);
+    fprintf(stderr, "        %s [options] -x TRACE [-v FACTEUR]\n", programme);
+    fprintf(stderr, "  -t         un thread par connexion (ancien modèle)\n");
+    fprintf(stderr, "  -w N       nombre de réacteurs epoll, chacun avec sa socket d'écoute\n");
+    fprintf(stderr, "             (1 à %d, défaut : nombre de coeurs)\n", MAX_REACTEURS);
+    fprintf(stderr, "  -q OCTETS  taille maximale de la file de sortie d'un client (défaut : %d)\n", LIMITE_FILE_SORTIE_DEFAUT);
+    fprintf(stderr, "  -p MODE    file pleine : ancien (jeter les plus anciens), deconnecter (défaut),\n");
+    fprintf(stderr, "             retard (ignorer les nouveaux messages jusqu'à ce que la file désemplisse)\n");
+    fprintf(stderr, "  -j FICHIER historique des messages (défaut : server_log.txt, - pour aucun)\n");
+    fprintf(stderr, "  -f MS      fdatasync de l'historique au plus une fois par MS millisecondes\n");
+    fprintf(stderr, "             (défaut : %d, 0 : à chaque lot)\n", DURABILITE_DEFAUT_MS);
+    fprintf(stderr, "  -H N       messages récents gardés par salon et rejoués à l'arrivée\n");
+    fprintf(stderr, "             (défaut : %d, 0 : aucun)\n", HISTORIQUE_DEFAUT);
+    fprintf(stderr, "  -O OCTETS  texte récent gardé au plus par salon (défaut : %d)\n", OCTETS_HISTORIQUE_DEFAUT);
+    fprintf(stderr, "  -a CHEMIN  socket Unix d'administration : statistiques, ou commandes ban, unban, bans\n");
+    fprintf(stderr, "  -b FICHIER bannissements du serveur au démarrage (cible [minutes] par ligne)\n");
+    fprintf(stderr, "  -d S       secondes pour donner un pseudo (défaut : %d, 0 : sans limite)\n", DELAI_INSCRIPTION_DEFAUT);
+    fprintf(stderr, "  -i S       déconnexion après S secondes sans rien recevoir (défaut : 0, jamais)\n");
+    fprintf(stderr, "  -l S       déconnexion d'un client dont la sortie n'avance plus depuis S secondes\n");
+    fprintf(stderr, "             (défaut : %d, 0 : jamais)\n", DELAI_LENTEUR_DEFAUT);
+    fprintf(stderr, "  -k S       sondes TCP keepalive après S secondes de silence (défaut : %d, 0 : aucune)\n", DELAI_KEEPALIVE_DEFAUT);
+    fprintf(stderr, "  -s S       session d'une connexion perdue gardée S secondes : pseudo, salon, rôle et\n");
+    fprintf(stderr, "             lignes manquées rendus à \"%s<jeton>\" (défaut : %d, 0 : aucune)\n",
+            COMMANDE_REPRISE, DELAI_SESSION_DEFAUT);
+    fprintf(stderr, "  -r N[/R]   lignes par seconde et par connexion, rafale de R (défaut : %d/%d, 0 : illimité) ;\n",
+            DEBIT_CLIENT_DEFAUT, RAFALE_CLIENT_DEFAUT);
+    fprintf(stderr, "             au-delà, la connexion n'est plus lue jusqu'au jeton suivant\n");
+    fprintf(stderr, "  -R N[/R]   lignes diffusées par seconde et par salon (défaut : 0, illimité)\n");
+    fprintf(stderr, "  -g US      fenêtre de regroupement des diffusions d'un salon actif, en µs :\n");
+    fprintf(stderr, "             un writev() par membre et par fenêtre (défaut : 0, aucun ; mode réacteur)\n");
+    fprintf(stderr, "  -F PORT    accepte les liens des autres nœuds de la grappe sur ce port\n");
+    fprintf(stderr, "  -L H:P     se relie au nœud H:P (répétable, au plus %d) ; salons et pseudos\n", MAX_PAIRS);
+    fprintf(stderr, "             sont communs à la grappe, chaque nœud devant être relié à tous\n");
+    fprintf(stderr, "  -K FICHIER secret partagé de la grappe (première ligne), exigé avec -F et -L ;\n");
+    fprintf(stderr, "             il circule en clair : réservez la grappe à un réseau de confiance\n");
+    fprintf(stderr, "  -c FICHIER cliché des salons, de leurs rôles et des bannissements, rechargé au\n");
+    fprintf(stderr, "             démarrage et réécrit quand il a changé\n");
+    fprintf(stderr, "  -C S       secondes entre deux clichés au plus (défaut : %d)\n", INTERVALLE_CLICHE_DEFAUT);
+    fprintf(stderr, "  -e FICHIER trace des entrées de chaque connexion, ajoutée au fichier\n");
+    fprintf(stderr, "  -x FICHIER rejoue une trace sans réseau, affiche le débit obtenu et quitte\n");
+    fprintf(stderr, "  -v FACTEUR vitesse du rejeu : 1 aux dates de la trace, 2 deux fois plus vite...\n");
+    fprintf(stderr, "             (défaut : 0, au plus vite) ; au rejeu, aucune limite de débit et aucun\n");
+    fprintf(stderr, "             historique sans -j explicite\n");
+    fprintf(stderr, "SIGUSR2 relance l'exécutable sans couper les connexions (mode réacteur)\n");
+    exit(EXIT_FAILURE);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage : %s <port>\n", argv[0]);
+    long nb_coeurs = sysconf(_SC_NPROCESSORS_ONLN);
+    int nombre_reacteurs = nb_coeurs > 0 ? (int)nb_coeurs : 1;
+    const char *chemin_journal = "server_log.txt";
+    int journal_demande = 0;
+    const char *chemin_administration = NULL;
+    const char *chemin_bans = NULL;
+    const char *chemin_trace = NULL, *chemin_rejeu = NULL;
+    double facteur_rejeu = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "tw:q:p:j:f:H:O:a:d:i:l:k:b:r:R:e:x:v:g:F:L:s:c:C:K:")) != -1) {
+        switch (option) {
+            case 't': mode_thread_par_connexion = 1; break;
+            case 'w': nombre_reacteurs = atoi(optarg); break;
+            case 'q': limite_file_sortie = (size_t)strtoul(optarg, NULL, 10); break;
+            case 'p':
+                if (strcmp(optarg, "ancien") == 0) politique_debordement = DEBORDEMENT_ANCIEN;
+                else if (strcmp(optarg, "deconnecter") == 0) politique_debordement = DEBORDEMENT_DECONNECTER;
+                else if (strcmp(optarg, "retard") == 0) politique_debordement = DEBORDEMENT_RETARD;
+                else afficher_usage(argv[0]);
+                break;
+            case 'j': chemin_journal = optarg; journal_demande = 1; break;
+            case 'f': journal.intervalle_durabilite_ms = atoi(optarg); break;
+            case 'H': capacite_historique = (size_t)strtoul(optarg, NULL, 10); break;
+            case 'O': octets_historique_max = (size_t)strtoul(optarg, NULL, 10); break;
+            case 'a': chemin_administration = optarg; break;
+            case 'd': delai_inscription_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'i': delai_inactivite_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'l': delai_lenteur_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'k': delai_keepalive_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 's': delai_session_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'c': chemin_cliche = optarg; break;
+            case 'C': intervalle_cliche_s = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'b': chemin_bans = optarg; break;
+            case 'r': if (analyser_debit(optarg, &debit_client) < 0) afficher_usage(argv[0]); break;
+            case 'R': if (analyser_debit(optarg, &debit_salon) < 0) afficher_usage(argv[0]); break;
+            case 'e': chemin_trace = optarg; break;
+            case 'x': chemin_rejeu = optarg; break;
+            case 'v': facteur_rejeu = strtod(optarg, NULL); break;
+            case 'g': fenetre_groupement_ns = strtoull(optarg, NULL, 10) * 1000; break;
+            case 'F': port_federation = (unsigned short)atoi(optarg); break;
+            case 'K':
+                if (charger_secret(optarg) < 0) {
+                    fprintf(stderr, "%s : secret de la grappe illisible ou vide\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'L':
+                if (ajouter_pair(optarg) < 0) {
+                    fprintf(stderr, "%s : pair invalide (HOTE:PORT, au plus %d)\n", optarg, MAX_PAIRS);
+                    afficher_usage(argv[0]);
+                }
+                break;
+            default: afficher_usage(argv[0]);
+        }
+    }
+    if (optind != argc - (chemin_rejeu ? 0 : 1) || facteur_rejeu < 0 || intervalle_cliche_s == 0 || journal.intervalle_durabilite_ms < 0 || nombre_reacteurs < 1 || nombre_reacteurs > MAX_REACTEURS || limite_file_sortie < MAX_MESSAGE ||
+        octets_historique_max < MAX_LIGNE_DIFFUSEE || octets_historique_max > limite_file_sortie) {
+        afficher_usage(argv[0]);
+    }
+    if ((port_federation || nb_pairs) && longueur_secret == 0) {
+        fprintf(stderr, "La fédération (-F, -L) exige un secret partagé (-K)\n");
         exit(EXIT_FAILURE);
     }
 
     srand((unsigned)time(NULL));
-    unsigned short port_serveur = (unsigned short)atoi(argv[1]);
+    unsigned short port_serveur = chemin_rejeu ? 0 : (unsigned short)atoi(argv[optind]);
+    if (chemin_rejeu) {
+        // Les jetons tirés au rejeu ne sont pas ceux de la trace : pas de reprise
+        mode_thread_par_connexion = 1;
+        delai_session_s = 0;
+        debit_client.intervalle_ns = debit_salon.intervalle_ns = 0;
+        if (!journal_demande) chemin_journal = "-";
+        struct stat rejeu, trace;
+        if (chemin_trace && stat(chemin_rejeu, &rejeu) == 0 && stat(chemin_trace, &trace) == 0 &&
+            rejeu.st_dev == trace.st_dev && rejeu.st_ino == trace.st_ino) {
+            fprintf(stderr, "%s : la trace rejouée ne peut pas recevoir le rejeu (-e)\n", chemin_trace);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    // Création de la socket d'écoute
-    int descripteur_serveur = socket(AF_INET, SOCK_STREAM, 0);
-    if (descripteur_serveur == -1) {
-        perror("socket");
+    // Un client disparu ne doit pas tuer le serveur pendant un write()
+    signal(SIGPIPE, SIG_IGN);
+
+    // Redémarrage à chaud : SIGUSR2 attendu par le thread principal seul (les
+    // threads créés ensuite héritent du masque) ; le canal d'un processus
+    // précédent est annoncé par VARIABLE_REPRISE
+    arguments_programme = argv;
+    ssize_t longueur_chemin = readlink("/proc/self/exe", chemin_executable, sizeof(chemin_executable) - 1);
+    if (longueur_chemin > 0) chemin_executable[longueur_chemin] = '\0';
+    else snprintf(chemin_executable, sizeof(chemin_executable), "%s", argv[0]);
+    const char *reprise = getenv(VARIABLE_REPRISE);
+    int canal_reprise = reprise ? atoi(reprise) : -1;
+    unsetenv(VARIABLE_REPRISE);
+    if (canal_reprise >= 0 && mode_thread_par_connexion) {
+        fprintf(stderr, "Reprise impossible en mode thread par connexion\n");
         exit(EXIT_FAILURE);
     }
+    sigset_t signaux_attendus;
+    sigemptyset(&signaux_attendus);
+    sigaddset(&signaux_attendus, SIGUSR2);
+    if (mode_thread_par_connexion) signal(SIGUSR2, SIG_IGN);
+    else pthread_sigmask(SIG_BLOCK, &signaux_attendus, NULL);
 
-    // Autoriser la réutilisation rapide de l'adresse
-    int opt = 1;
-    setsockopt(descripteur_serveur, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // Autant de connexions que le système le permet
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0 && limite.rlim_cur < limite.rlim_max) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
 
-    struct sockaddr_in adresse;
-    memset(&adresse, 0, sizeof(adresse));
-    adresse.sin_family = AF_INET;
-    adresse.sin_port = htons(port_serveur);
-    adresse.sin_addr.s_addr = INADDR_ANY;
+    index_initialiser(&index_pseudos, 1);
+    index_initialiser(&index_salons, 1);
+    index_initialiser(&index_pseudos_distants, 1);
+    index_initialiser(&index_sessions, 1);
+    index_initialiser(&index_sessions_pseudos, 1);
+    index_initialiser(&index_titulaires, 1);
+    if (getentropy(&identifiant_noeud, sizeof(identifiant_noeud)) == -1 || identifiant_noeud == 0) {
+        identifiant_noeud = ((uint64_t)getpid() << 32) ^ horloge_ns();
+    }
 
-    if (bind(descripteur_serveur, (struct sockaddr *)&adresse, sizeof(adresse)) == -1) {
-        perror("bind"); close(descripteur_serveur); exit(EXIT_FAILURE);
+    if (strcmp(chemin_journal, "-") != 0) {
+        demarrer_journal(chemin_journal);
+        printf(">>> Historique dans %s (fdatasync toutes les %d ms au plus)\n", chemin_journal, journal.intervalle_durabilite_ms);
     }
-    if (listen(descripteur_serveur, 10) == -1) {
-        perror("listen"); close(descripteur_serveur); exit(EXIT_FAILURE);
+    if (capacite_historique > 0) {
+        printf(">>> %zu messages récents gardés par salon (%zu octets au plus)\n", capacite_historique, octets_historique_max);
+    }
+    if (debit_client.intervalle_ns) {
+        printf(">>> Au plus %llu lignes/s par connexion\n", NS_PAR_S / debit_client.intervalle_ns);
+    }
+    if (debit_salon.intervalle_ns) {
+        printf(">>> Au plus %llu lignes diffusées/s par salon\n", NS_PAR_S / debit_salon.intervalle_ns);
+    }
+    if (delai_session_s > 0 && !chemin_rejeu) {
+        demarrer_sessions();
+        printf(">>> Sessions coupées gardées %u s pour reprise\n", delai_session_s);
+    }
+    if (fenetre_groupement_ns && !mode_thread_par_connexion) {
+        printf(">>> Diffusions d'un salon actif regroupées par fenêtres de %llu µs\n",
+               (unsigned long long)(fenetre_groupement_ns / 1000));
     }
 
-    printf(">>> Serveur en écoute sur le port %d...\n", port_serveur);
-
-    // Création du salon par défaut (lobby)
+    // Création du salon par défaut (lobby), partagé entre tous les réacteurs
+    if (!mode_thread_par_connexion) nb_partitions = nombre_reacteurs;
     salon_par_defaut = obtenir_ou_creer_salon("lobby");
+    // Un remplaçant reçoit bannissements, salons et rôles avec l'état
+    // transmis : le fichier -b relu rendrait les bannissements levés depuis
+    if (chemin_bans && canal_reprise < 0) charger_bans(chemin_bans);
+    if (chemin_cliche && canal_reprise < 0 && !chemin_rejeu) charger_cliche();
+    if (chemin_trace) {
+        ouvrir_trace(chemin_trace);
+        printf(">>> Entrées tracées dans %s\n", chemin_trace);
+    }
+    if (chemin_rejeu) {
+        rejouer_trace(chemin_rejeu, facteur_rejeu);
+        if (strcmp(chemin_journal, "-") != 0) attendre_journal();
+        return 0;
+    }
+
+    if (chemin_cliche) {
+        demarrer_cliche();
+        printf(">>> Cliché dans %s (toutes les %u s au plus)\n", chemin_cliche, intervalle_cliche_s);
+    }
+    if (chemin_administration) {
+        demarrer_administration(chemin_administration);
+        printf(">>> Statistiques sur la socket %s\n", chemin_administration);
+    }
+
+    if (!mode_thread_par_connexion) {
+        if (canal_reprise >= 0) reprendre_service(canal_reprise, nombre_reacteurs, port_serveur);
+        else preparer_reacteurs(nombre_reacteurs, port_serveur, NULL, 0);
+        if (port_federation || nb_pairs) demarrer_federation();
+        lancer_reacteurs();
+        printf(">>> Serveur en écoute sur le port %d (pid %d)...\n", port_serveur, (int)getpid());
+        printf(">>> %d réacteur(s) epoll\n", nb_reacteurs);
+        printf(">>> Mémoire par connexion (hors tampons noyau) : ~%zu octets\n", octets_par_connexion());
+        // Les réacteurs acceptent eux-mêmes leurs connexions ; il ne reste
+        // qu'à attendre une demande de redémarrage à chaud
+        for (;;) {
+            int signal_recu;
+            if (sigwait(&signaux_attendus, &signal_recu) == 0 && signal_recu == SIGUSR2) {
+                printf(">>> Redémarrage à chaud demandé\n");
+                redemarrer_a_chaud();
+            }
+        }
+    }
+
+    int descripteur_serveur = ouvrir_socket_ecoute(port_serveur, 0);
+    if (port_federation || nb_pairs) demarrer_federation();
+    printf(">>> Serveur en écoute sur le port %d...\n", port_serveur);
+    printf(">>> Un thread par connexion\n");
+    printf(">>> Mémoire par connexion (hors tampons noyau) : ~%zu octets\n", octets_par_connexion());
 
     // Boucle d'acceptation des connexions entrantes
     while (1) {
         struct sockaddr_in addr_client;
         socklen_t taille = sizeof(addr_client);
-        int *pointeur_desc = malloc(sizeof(int));
-        if (!pointeur_desc) { perror("malloc"); continue; }
-        *pointeur_desc = accept(descripteur_serveur, (struct sockaddr *)&addr_client, &taille);
-        if (*pointeur_desc == -1) {
-            perror("accept"); free(pointeur_desc); continue;
+        int descripteur = accept(descripteur_serveur, (struct sockaddr *)&addr_client, &taille);
+        if (descripteur == -1) {
+            perror("accept"); continue;
         }
+        uint32_t adresse = ntohl(addr_client.sin_addr.s_addr);
+        if (adresse_bannie(adresse)) {
+            close(descripteur);
+            compter(STAT_CONNEXIONS_REFUSEES, 1);
+            continue;
+        }
+        compter(STAT_CONNEXIONS, 1);
+        regler_connexion(descripteur);
+
+        connexion_acceptee_t *connexion = malloc(sizeof(connexion_acceptee_t));
+        if (!connexion) { perror("malloc"); close(descripteur); continue; }
+        connexion->descripteur = descripteur;
+        connexion->adresse = adresse;
         pthread_t id_thread;
-        pthread_create(&id_thread, NULL, gerer_un_client, pointeur_desc);
+        pthread_create(&id_thread, NULL, gerer_un_client, connexion);
         pthread_detach(id_thread);
     }
 
     close(descripteur_serveur);
     return 0;
-}
\ No newline at end of file
+}